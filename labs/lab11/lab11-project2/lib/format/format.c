@@ -0,0 +1,161 @@
+/***********************************************************************
+ *
+ * Integer number formatting for LCD and UART output.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <format.h>
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: fmt_field()
+ * Purpose:  Copy characters stored in reverse order to right aligned
+ *           field.
+ * Input(s): buf - Destination
+ *           tmp - Characters, the least significant one first
+ *           len - Number of characters in tmp
+ *           width - Field width, 0 for no padding
+ * Returns:  Pointer behind the last written character
+ **********************************************************************/
+static char *fmt_field(char *buf, const char *tmp, uint8_t len, uint8_t width)
+{
+    if (width == 0)
+    {
+        width = len;
+    }
+    else if (len > width)
+    {
+        // Number does not fit, do not overwrite the neighbours
+        while (width--)
+            *buf++ = '#';
+        return buf;
+    }
+
+    while (width > len)
+    {
+        *buf++ = ' ';
+        width--;
+    }
+    while (len)
+        *buf++ = tmp[--len];
+
+    return buf;
+}
+
+
+/**********************************************************************
+ * Function: fmt_number()
+ * Purpose:  Write decimal number with optional sign and decimal point.
+ * Input(s): buf - Destination
+ *           value - Absolute value of the number
+ *           negative - Nonzero for minus sign
+ *           width - Field width, 0 for no padding
+ *           decimals - Number of decimal places
+ * Returns:  Pointer behind the last written character
+ **********************************************************************/
+static char *fmt_number(char *buf, uint16_t value, uint8_t negative,
+                        uint8_t width, uint8_t decimals)
+{
+    char tmp[8];  // "-6.5535" or "-65535" in reverse order
+    uint8_t len = 0;
+    uint8_t min_len;
+
+    if (decimals > FMT_DECIMALS_MAX)
+        decimals = FMT_DECIMALS_MAX;
+    // At least one digit in front of the decimal point
+    min_len = (decimals) ? decimals + 2 : 1;
+
+    do
+    {
+        if (decimals != 0 && len == decimals)
+        {
+            tmp[len++] = '.';
+        }
+        else
+        {
+            tmp[len++] = '0' + (value % 10);
+            value /= 10;
+        }
+    } while (value != 0 || len < min_len);
+
+    if (negative)
+        tmp[len++] = '-';
+
+    return fmt_field(buf, tmp, len, width);
+}
+
+
+/**********************************************************************
+ * Function: fmt_dec()
+ * Purpose:  Write unsigned decimal number padded by spaces.
+ * Input(s): buf - Destination
+ *           value - Number to be written
+ *           width - Field width, 0 for no padding
+ * Returns:  Pointer behind the last written character
+ **********************************************************************/
+char *fmt_dec(char *buf, uint16_t value, uint8_t width)
+{
+    return fmt_number(buf, value, 0, width, 0);
+}
+
+
+/**********************************************************************
+ * Function: fmt_fixed()
+ * Purpose:  Write signed fixed-point number padded by spaces.
+ * Input(s): buf - Destination
+ *           value - Number scaled by 10^decimals
+ *           width - Field width, 0 for no padding
+ *           decimals - Number of decimal places
+ * Returns:  Pointer behind the last written character
+ **********************************************************************/
+char *fmt_fixed(char *buf, int16_t value, uint8_t width, uint8_t decimals)
+{
+    if (value < 0)
+        return fmt_number(buf, -(uint16_t)value, 1, width, decimals);
+    else
+        return fmt_number(buf, value, 0, width, decimals);
+}
+
+
+/**********************************************************************
+ * Function: fmt_hex()
+ * Purpose:  Write hexadecimal number with leading zeros.
+ * Input(s): buf - Destination
+ *           value - Number to be written
+ *           digits - Number of digits
+ * Returns:  Pointer behind the last written character
+ **********************************************************************/
+char *fmt_hex(char *buf, uint16_t value, uint8_t digits)
+{
+    uint8_t nibble;
+
+    while (digits--)
+    {
+        nibble = (value >> (digits * 4)) & 0x0f;
+        *buf++ = (nibble < 10) ? '0' + nibble : 'a' - 10 + nibble;
+    }
+    return buf;
+}
+
+
+/**********************************************************************
+ * Function: fmt_bin()
+ * Purpose:  Write binary number with leading zeros.
+ * Input(s): buf - Destination
+ *           value - Number to be written
+ *           digits - Number of digits
+ * Returns:  Pointer behind the last written character
+ **********************************************************************/
+char *fmt_bin(char *buf, uint16_t value, uint8_t digits)
+{
+    while (digits--)
+        *buf++ = (value & (1U << digits)) ? '1' : '0';
+    return buf;
+}
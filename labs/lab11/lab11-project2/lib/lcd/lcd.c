@@ -30,7 +30,12 @@
 # define F_CPU 16000000
 #endif
 #include <util/delay.h>
+#include <util/atomic.h>
 #include "lcd.h"
+#if LCD_ASYNC
+# include <avr/interrupt.h>
+# include <ring.h>
+#endif
 
 
 /*
@@ -45,6 +50,23 @@
 #endif
 
 
+#if LCD_IO_MODE
+/* data lines on one port and on consecutive pins: nibble written with one masked store */
+# define LCD_DATA_MASK (0x0F << LCD_DATA0_PIN)
+# if (LCD_DATA1_PIN == LCD_DATA0_PIN + 1) && (LCD_DATA2_PIN == LCD_DATA0_PIN + 2) && (LCD_DATA3_PIN == LCD_DATA0_PIN + 3)
+#  define lcd_data_contiguous() ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) )
+# else
+#  define lcd_data_contiguous() 0
+# endif
+/* the masked store is a read-modify-write of the whole port, done with interrupts disabled so that
+   an ISR changing other pins of the port meanwhile is not undone; with LCD_ASYNC the store runs in
+   TIMER2_COMPA ISR, so the main program must change other pins of LCD_DATA0_PORT atomically too,
+   i.e. by sbi/cbi (|= or &= with one constant bit) or with interrupts disabled */
+# define lcd_data_store(bits) \
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { LCD_DATA0_PORT = (LCD_DATA0_PORT & ~LCD_DATA_MASK) | ((bits) & LCD_DATA_MASK); }
+#endif
+
+
 #if LCD_IO_MODE
 # define lcd_e_delay()  _delay_us(LCD_DELAY_ENABLE_PULSE)
 # define lcd_e_high()   LCD_E_PORT |= _BV(LCD_E_PIN);
@@ -85,6 +107,7 @@
 */
 #if LCD_IO_MODE
 static void toggle_e(void);
+static uint8_t lcd_read(uint8_t rs);
 #endif
 
 /*
@@ -111,6 +134,35 @@ static void toggle_e(void)
 #endif
 
 
+/*************************************************************************
+*  Low-level function to output one nibble and strobe Enable pin
+*  Input:    nibble  value in bits 0..3
+*  Returns:  none
+*************************************************************************/
+#if LCD_IO_MODE
+static void lcd_write_nibble(uint8_t nibble)
+{
+    if (lcd_data_contiguous())
+    {
+        lcd_data_store(nibble << LCD_DATA0_PIN);
+    }
+    else
+    {
+        LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
+        LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
+        LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
+        LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
+        if (nibble & 0x08) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
+        if (nibble & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
+        if (nibble & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
+        if (nibble & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
+    }
+    lcd_e_toggle();
+} /* lcd_write_nibble */
+
+#endif
+
+
 /*************************************************************************
 *  Low-level function to write byte to LCD controller
 *  Input:    data   byte to write to LCD
@@ -118,12 +170,9 @@ static void toggle_e(void)
 *                0: write instruction
 *  Returns:  none
 *************************************************************************/
-#if LCD_IO_MODE
+#if LCD_IO_MODE && !LCD_ASYNC /* asynchronous mode writes from lcd_queue_step() */
 static void lcd_write(uint8_t data, uint8_t rs)
 {
-    unsigned char dataBits;
-
-
     if (rs) /* write data        (RS=1, RW=0) */
     {
         lcd_rs_high();
@@ -133,26 +182,24 @@ static void lcd_write(uint8_t data, uint8_t rs)
         lcd_rs_low();
     }
 
+    #if LCD_RW_WIRED
+    lcd_rw_low();        /* RW=0  write mode      */
+    #else
     /* FRYZA: RW PIN NOT IMPLEMENTED */
     /*lcd_rw_low();*/    /* RW=0  write mode      */
+    #endif
 
-    if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) &&
-      (LCD_DATA0_PIN == 0) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    if (lcd_data_contiguous())
     {
         /* configure data pins as output */
-        DDR(LCD_DATA0_PORT) |= 0x0F;
-
-        /* output high nibble first */
-        dataBits       = LCD_DATA0_PORT & 0xF0;
-        LCD_DATA0_PORT = dataBits | ((data >> 4) & 0x0F);
-        lcd_e_toggle();
+        DDR(LCD_DATA0_PORT) |= LCD_DATA_MASK;
 
-        /* output low nibble */
-        LCD_DATA0_PORT = dataBits | (data & 0x0F);
-        lcd_e_toggle();
+        /* output high nibble first, then low nibble */
+        lcd_write_nibble(data >> 4);
+        lcd_write_nibble(data);
 
         /* all data pins high (inactive) */
-        LCD_DATA0_PORT = dataBits | 0x0F;
+        lcd_data_store(LCD_DATA_MASK);
     }
     else
     {
@@ -162,49 +209,168 @@ static void lcd_write(uint8_t data, uint8_t rs)
         DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
         DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
 
-        /* output high nibble first */
-        LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
-        LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
-        LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
-        LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
-        if (data & 0x80) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-        if (data & 0x40) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-        if (data & 0x20) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-        if (data & 0x10) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-        lcd_e_toggle();
-
-        /* output low nibble */
-        LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
-        LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
-        LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
-        LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
-        if (data & 0x08) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-        if (data & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-        if (data & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-        if (data & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-        lcd_e_toggle();
+        /* output high nibble first, then low nibble */
+        lcd_write_nibble(data >> 4);
+        lcd_write_nibble(data);
 
         /* all data pins high (inactive) */
         LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
         LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
         LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
         LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-
-        /* FRYZA: EXPERIMENTALLY ADDED FOR ARDUINO UNO and LCD KEYPAD SHIELD
-         * Delay MUST be greater than 679 us for blue-light background LCD Keypad Shield
-         * Delay MUST be greater than 754 us for green-yellow-light background LCD Keypad Shield
-         */
-        _delay_us(800);
     }
+
+    #if !LCD_RW_WIRED
+    /* FRYZA: EXPERIMENTALLY ADDED FOR ARDUINO UNO and LCD KEYPAD SHIELD
+     * Delay MUST be greater than 679 us for blue-light background LCD Keypad Shield
+     * Delay MUST be greater than 754 us for green-yellow-light background LCD Keypad Shield
+     */
+    _delay_us(LCD_DELAY_WRITE);
+    #endif
 } /* lcd_write */
 
-#else /* if LCD_IO_MODE */
+#elif !LCD_IO_MODE
 # define lcd_write(d, rs) if (rs) *(volatile uint8_t *) (LCD_IO_DATA) = d; else *(volatile uint8_t *) (LCD_IO_FUNCTION) = d;
 /* rs==0 -> write instruction to LCD_IO_FUNCTION */
 /* rs==1 -> write data to LCD_IO_DATA */
 #endif /* if LCD_IO_MODE */
 
 
+#if LCD_ASYNC
+/*************************************************************************
+*  Interrupt driven write queue
+*  Timer/Counter2 runs in CTC mode with clk/256, so one OCR2A step is
+*  16 us at 16 MHz. Every compare match outputs one nibble, OCR2A then
+*  holds the time to wait before the next nibble, rounded up to whole
+*  ticks.
+*************************************************************************/
+# if !LCD_IO_MODE
+#  error "LCD_ASYNC requires 4-bit IO port mode"
+# endif
+# define LCD_QUEUE_TICKS(us) ((uint8_t)(((F_CPU / 256UL) * (us) + 999999UL) / 1000000UL))
+# if ((F_CPU / 256UL) * LCD_DELAY_CLEAR + 999999UL) / 1000000UL > 255
+#  error "LCD_DELAY_CLEAR does not fit into OCR2A"
+# endif
+
+typedef struct
+{
+    uint8_t data;
+    uint8_t rs;
+} lcd_entry_t;
+
+/* queue of lcd_entry_t, lcd functions write and the interrupt reads it */
+RING_DEFINE(lcd_queue, lcd_entry_t, LCD_QUEUE_SIZE)
+
+static lcd_queue_t lcd_queue;
+static lcd_entry_t lcd_queue_cur;  /* entry being written */
+static volatile uint8_t lcd_queue_low; /* 1: low nibble of lcd_queue_cur is next */
+
+
+/*************************************************************************
+*  Generate the next compare match after ticks periods of Timer/Counter2.
+*  TCNT2 is restarted, with OCR2A below the running counter the match
+*  would come only after the counter wraps, i.e. 4 ms later.
+*  Input:    ticks  OCR2A steps to wait, 0 for the next tick
+*  Returns:  none
+*************************************************************************/
+static void lcd_queue_wait(uint8_t ticks)
+{
+    TCNT2 = 0;
+    OCR2A = ticks;
+}
+
+
+/*************************************************************************
+*  Output next nibble from the queue, called on Timer/Counter2 compare match
+*  Returns:  none
+*************************************************************************/
+static void lcd_queue_step(void)
+{
+    if (!lcd_queue_low)
+    {
+        if (lcd_queue_count(&lcd_queue) == 0)
+        {
+            /* nothing to do, the last instruction has had its time already */
+            TIMSK2 &= ~_BV(OCIE2A);
+            return;
+        }
+        #if LCD_RW_WIRED
+        /* controller still busy, poll again on the next tick */
+        if (lcd_read(0) & (1 << LCD_BUSY))
+        {
+            lcd_queue_wait(0);
+            return;
+        }
+        lcd_rw_low();
+        if (lcd_data_contiguous())
+        {
+            DDR(LCD_DATA0_PORT) |= LCD_DATA_MASK;
+        }
+        else
+        {
+            DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
+            DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
+            DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
+            DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
+        }
+        #endif
+        lcd_queue_pop(&lcd_queue, &lcd_queue_cur);
+        if (lcd_queue_cur.rs)
+            lcd_rs_high();
+        else
+            lcd_rs_low();
+        lcd_write_nibble(lcd_queue_cur.data >> 4);
+        lcd_queue_low = 1;
+        lcd_queue_wait(0); /* low nibble on the next tick */
+    }
+    else
+    {
+        lcd_write_nibble(lcd_queue_cur.data);
+        lcd_queue_low = 0;
+
+        /* clear display and return home take much longer than the rest */
+        if (!lcd_queue_cur.rs && lcd_queue_cur.data <= ((1 << LCD_HOME) | (1 << LCD_CLR)))
+            lcd_queue_wait(LCD_QUEUE_TICKS(LCD_DELAY_CLEAR));
+        else if (LCD_RW_WIRED)
+            lcd_queue_wait(0); /* busy flag is checked before the next byte */
+        else
+            lcd_queue_wait(LCD_QUEUE_TICKS(LCD_DELAY_WRITE));
+    }
+} /* lcd_queue_step */
+
+
+ISR(TIMER2_COMPA_vect)
+{
+    lcd_queue_step();
+}
+
+
+/*************************************************************************
+*  Store byte into the write queue, wait if the queue is full
+*  Input:    data   byte to write to LCD
+*         rs     1: write data
+*                0: write instruction
+*  Returns:  none
+*************************************************************************/
+static void lcd_queue_put(uint8_t data, uint8_t rs)
+{
+    lcd_entry_t entry = { data, rs };
+
+    while (!lcd_queue_push(&lcd_queue, entry))
+    {
+        /* called with interrupts disabled, serve the compare match here */
+        if (!(SREG & _BV(SREG_I)) && (TIFR2 & _BV(OCF2A)))
+        {
+            TIFR2 = _BV(OCF2A);
+            lcd_queue_step();
+        }
+    }
+    TIMSK2 |= _BV(OCIE2A);
+} /* lcd_queue_put */
+
+#endif /* if LCD_ASYNC */
+
+
 /*************************************************************************
 *  Low-level function to read byte from LCD controller
 *  Input:    rs     1: read data
@@ -212,7 +378,7 @@ static void lcd_write(uint8_t data, uint8_t rs)
 *  Returns:  byte read from LCD controller
 *************************************************************************/
 #if LCD_IO_MODE
-/* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE THIS FUNCTION */
+/* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE THIS FUNCTION, UNLESS LCD_RW_WIRED */
 static uint8_t lcd_read(uint8_t rs)
 {
     uint8_t data;
@@ -223,21 +389,20 @@ static uint8_t lcd_read(uint8_t rs)
         lcd_rs_low();  /* RS=0: read busy flag */
     lcd_rw_high();     /* RW=1  read mode      */
 
-    if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) &&
-      ( LCD_DATA0_PIN == 0 ) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    if (lcd_data_contiguous())
     {
-        DDR(LCD_DATA0_PORT) &= 0xF0; /* configure data pins as input */
+        DDR(LCD_DATA0_PORT) &= ~LCD_DATA_MASK; /* configure data pins as input */
 
         lcd_e_high();
         lcd_e_delay();
-        data = PIN(LCD_DATA0_PORT) << 4; /* read high nibble first */
+        data = ((PIN(LCD_DATA0_PORT) & LCD_DATA_MASK) >> LCD_DATA0_PIN) << 4; /* read high nibble first */
         lcd_e_low();
 
         lcd_e_delay(); /* Enable 500ns low       */
 
         lcd_e_high();
         lcd_e_delay();
-        data |= PIN(LCD_DATA0_PORT) & 0x0F; /* read low nibble        */
+        data |= (PIN(LCD_DATA0_PORT) & LCD_DATA_MASK) >> LCD_DATA0_PIN; /* read low nibble        */
         lcd_e_low();
     }
     else
@@ -282,7 +447,7 @@ static uint8_t lcd_read(uint8_t rs)
 /*************************************************************************
 *  loops while lcd is busy, returns address counter
 *************************************************************************/
-/* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE THIS FUNCTION */
+/* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE THIS FUNCTION, UNLESS LCD_RW_WIRED */
 static uint8_t lcd_waitbusy(void)
 {
     register uint8_t c;
@@ -350,9 +515,16 @@ static inline void lcd_newline(uint8_t pos)
 *************************************************************************/
 void lcd_command(uint8_t cmd)
 {
+    #if LCD_ASYNC
+    lcd_queue_put(cmd, 0);
+    #elif LCD_RW_WIRED
+    lcd_waitbusy();
+    lcd_write(cmd, 0);
+    #else
     /* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE READ FUNCTION */
     /* lcd_waitbusy(); */
     lcd_write(cmd, 0);
+    #endif
 }
 
 /*************************************************************************
@@ -362,9 +534,16 @@ void lcd_command(uint8_t cmd)
 *************************************************************************/
 void lcd_data(uint8_t data)
 {
+    #if LCD_ASYNC
+    lcd_queue_put(data, 1);
+    #elif LCD_RW_WIRED
+    lcd_waitbusy();
+    lcd_write(data, 1);
+    #else
     /* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE READ FUNCTION */
     /* lcd_waitbusy(); */
     lcd_write(data, 1);
+    #endif
 }
 
 /*************************************************************************
@@ -398,7 +577,7 @@ void lcd_gotoxy(uint8_t x, uint8_t y)
 
 /*************************************************************************
 *************************************************************************/
-/* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE THIS FUNCTION */
+/* FRYZA: RW PIN NOT IMPLEMENTED ==> DO NOT USE THIS FUNCTION, UNLESS LCD_RW_WIRED */
 int lcd_getxy(void)
 {
     return lcd_waitbusy();
@@ -463,7 +642,7 @@ void lcd_putc(char c)
      *      lcd_waitbusy();
      #endif
      */
-    lcd_write(c, 1);
+    lcd_data(c);
     //    }
 }/* lcd_putc */
 
@@ -523,11 +702,10 @@ void lcd_init(uint8_t dispAttr)
         /* configure all port bits as output (all LCD lines on same port) */
         DDR(LCD_DATA0_PORT) |= 0x7F;
     }
-    else if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) &&
-      (LCD_DATA0_PIN == 0 ) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    else if (lcd_data_contiguous())
     {
         /* configure all port bits as output (all LCD data lines on same port, but control lines on different ports) */
-        DDR(LCD_DATA0_PORT) |= 0x0F;
+        DDR(LCD_DATA0_PORT) |= LCD_DATA_MASK;
         DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
         DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
         DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
@@ -565,6 +743,13 @@ void lcd_init(uint8_t dispAttr)
     delay(LCD_DELAY_INIT_4BIT); /* some displays need this additional delay */
 
     /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */
+
+    #if LCD_ASYNC
+    /* Timer/Counter2 in CTC mode, clk/256, drains the write queue */
+    TCCR2A = _BV(WGM21);
+    TCCR2B = _BV(CS22) | _BV(CS21);
+    lcd_queue_wait(LCD_QUEUE_TICKS(LCD_DELAY_INIT_4BIT));
+    #endif
     #else /* if LCD_IO_MODE */
 
     /*
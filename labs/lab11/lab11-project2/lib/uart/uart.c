@@ -39,7 +39,16 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <string.h>
+#include <ring.h>
 #include "uart.h"
+#if ISRSTAT
+# include <isrstat.h>
+#else
+# define ISRSTAT_ENTER(id)
+# define ISRSTAT_EXIT(id)
+#endif
 
 
 /*
@@ -47,15 +56,29 @@
  */
 
 /* size of RX/TX buffers */
-#define UART_RX_BUFFER_MASK ( UART_RX_BUFFER_SIZE - 1)
-#define UART_TX_BUFFER_MASK ( UART_TX_BUFFER_SIZE - 1)
-
-#if ( UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK )
+#if ( UART_RX_BUFFER_SIZE & ( UART_RX_BUFFER_SIZE - 1 ) )
 # error RX buffer size is not a power of 2
 #endif
-#if ( UART_TX_BUFFER_SIZE & UART_TX_BUFFER_MASK )
+#if ( UART_TX_BUFFER_SIZE & ( UART_TX_BUFFER_SIZE - 1 ) )
 # error TX buffer size is not a power of 2
 #endif
+#if ( UART_RX_BUFFER_SIZE < 2 ) || ( UART_RX_BUFFER_SIZE > 256 )
+# error RX buffer size must be 2 to 256, buffer indexes are 8-bit
+#endif
+#if ( UART_TX_BUFFER_SIZE < 2 ) || ( UART_TX_BUFFER_SIZE > 256 )
+# error TX buffer size must be 2 to 256, buffer indexes are 8-bit
+#endif
+
+#if UART_RX_LINE_MODE && ( ( UART_LINE_SIZE < 2 ) || ( UART_LINE_SIZE > 255 ) )
+# error line buffer size must be 2 to 255
+#endif
+#if UART_TX_PINGPONG && ( ( UART_PP_BUFFER_SIZE < 1 ) || ( UART_PP_BUFFER_SIZE > 255 ) )
+# error ping-pong buffer size must be 1 to 255
+#endif
+
+/* ringbuffer types uart_rx_ring_t and uart_tx_ring_t, see ring.h */
+RING_DEFINE(uart_rx_ring, unsigned char, UART_RX_BUFFER_SIZE)
+RING_DEFINE(uart_tx_ring, unsigned char, UART_TX_BUFFER_SIZE)
 
 
 #if defined(__AVR_AT90S2313__) || defined(__AVR_AT90S4414__) || defined(__AVR_AT90S8515__) || \
@@ -338,25 +361,87 @@
 /*
  *  module global variables
  */
-static volatile unsigned char UART_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART_TxHead;
-static volatile unsigned char UART_TxTail;
-static volatile unsigned char UART_RxHead;
-static volatile unsigned char UART_RxTail;
+static uart_tx_ring_t UART_TxRing;
+static uart_rx_ring_t UART_RxRing;
 static volatile unsigned char UART_LastRxError;
+#if UART_TX_POLICY != UART_TX_BLOCK
+static volatile unsigned int  UART_TxDropped;
+#endif
+
+#if UART_RX_LINE_MODE
+static char UART_LineBuf[2][UART_LINE_SIZE];
+static volatile unsigned char UART_LineFill;    /* buffer being assembled by ISR   */
+static volatile unsigned char UART_LineLen;     /* characters in UART_LineFill     */
+static volatile unsigned char UART_LineReady;   /* other buffer holds a line       */
+static volatile unsigned char UART_LinePending; /* UART_LineFill complete, no swap */
+static volatile unsigned char UART_LineHeld;    /* other buffer lent to the caller */
+#endif
+
+#if UART_TX_PINGPONG
+static unsigned char UART_PpBuf[2][UART_PP_BUFFER_SIZE];
+static volatile unsigned char UART_PpFill;      /* buffer being filled by producer   */
+static volatile unsigned char UART_PpLen[2];    /* bytes to send, 0 when buffer free */
+static volatile unsigned char UART_PpPos;       /* next byte of the other buffer     */
+static volatile unsigned int  UART_PpOverruns;
+#endif
 
 #if defined( ATMEGA_USART1 )
-static volatile unsigned char UART1_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART1_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART1_TxHead;
-static volatile unsigned char UART1_TxTail;
-static volatile unsigned char UART1_RxHead;
-static volatile unsigned char UART1_RxTail;
+static uart_tx_ring_t UART1_TxRing;
+static uart_rx_ring_t UART1_RxRing;
 static volatile unsigned char UART1_LastRxError;
 #endif
 
 
+#if UART_RX_LINE_MODE
+/*************************************************************************
+ * Function: uart_line_put()
+ * Purpose:  add received character to the line being assembled,
+ *           called from UART Receive Complete interrupt
+ * Input:    received character and receive error bits
+ * Returns:  none
+ **************************************************************************/
+static inline void uart_line_put(unsigned char data, unsigned char lastRxError)
+{
+    unsigned char fill = UART_LineFill;
+
+
+    if (UART_LinePending)
+    {
+        /* both buffers occupied, drop characters until uart_getline() */
+        return;
+    }
+
+    if (lastRxError)
+    {
+        /* corrupted character, discard the whole line */
+        UART_LineLen = 0xff;
+    }
+    else if (data == '\r' || data == '\n')
+    {
+        if (UART_LineLen != 0 && UART_LineLen != 0xff)
+        {
+            UART_LineBuf[fill][UART_LineLen] = '\0';
+            if (UART_LineReady)
+            {
+                UART_LinePending = 1;
+                return;
+            }
+            /* swap buffers */
+            UART_LineFill  = fill ^ 1;
+            UART_LineReady = 1;
+        }
+        UART_LineLen = 0;
+    }
+    else if (UART_LineLen < UART_LINE_SIZE - 1)
+    {
+        UART_LineBuf[fill][UART_LineLen++] = data;
+    }
+    /* else line too long, it is truncated */
+}/* uart_line_put */
+
+#endif
+
+
 ISR(UART0_RECEIVE_INTERRUPT)
 
 /*************************************************************************
@@ -364,7 +449,7 @@ ISR(UART0_RECEIVE_INTERRUPT)
  * Purpose:  called when the UART has received a character
  **************************************************************************/
 {
-    unsigned char tmphead;
+    ISRSTAT_ENTER(ISRSTAT_UART_RX);
     unsigned char data;
     unsigned char usr;
     unsigned char lastRxError = 0;
@@ -385,22 +470,18 @@ ISR(UART0_RECEIVE_INTERRUPT)
     lastRxError = usr & (_BV(FE) | _BV(DOR) );
     #endif
 
-    /* calculate buffer index */
-    tmphead = ( UART_RxHead + 1) & UART_RX_BUFFER_MASK;
-
-    if (tmphead == UART_RxTail)
+    #if UART_RX_LINE_MODE
+    uart_line_put(data, lastRxError);
+    #else
+    /* store received data in buffer */
+    if (!uart_rx_ring_push(&UART_RxRing, data))
     {
         /* error: receive buffer overflow */
         lastRxError = UART_BUFFER_OVERFLOW >> 8;
     }
-    else
-    {
-        /* store new index */
-        UART_RxHead = tmphead;
-        /* store received data in buffer */
-        UART_RxBuf[tmphead] = data;
-    }
     UART_LastRxError |= lastRxError;
+    #endif
+    ISRSTAT_EXIT(ISRSTAT_UART_RX);
 }
 
 
@@ -411,22 +492,41 @@ ISR(UART0_TRANSMIT_INTERRUPT)
  * Purpose:  called when the UART is ready to transmit the next byte
  **************************************************************************/
 {
-    unsigned char tmptail;
+    ISRSTAT_ENTER(ISRSTAT_UART_UDRE);
+    unsigned char data;
+    #if UART_TX_PINGPONG
+    unsigned char tx = UART_PpFill ^ 1;
+    unsigned char pos;
 
 
-    if (UART_TxHead != UART_TxTail)
+    if (UART_PpLen[tx] && (UART_PpPos || uart_tx_ring_count(&UART_TxRing) == 0))
+    {
+        /* block starts once the ringbuffer is empty and is sent as a whole */
+        pos        = UART_PpPos;
+        UART0_DATA = UART_PpBuf[tx][pos++];
+        UART_PpPos = pos;
+        if (pos == UART_PpLen[tx])
+        {
+            /* block sent, buffer free for the producer */
+            UART_PpLen[tx] = 0;
+        }
+        ISRSTAT_EXIT(ISRSTAT_UART_UDRE);
+        return;
+    }
+    #endif
+
+
+    if (uart_tx_ring_pop(&UART_TxRing, &data))
     {
-        /* calculate and store new buffer index */
-        tmptail     = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART_TxTail = tmptail;
         /* get one byte from buffer and write it to UART */
-        UART0_DATA = UART_TxBuf[tmptail]; /* start transmission */
+        UART0_DATA = data; /* start transmission */
     }
     else
     {
         /* tx buffer empty, disable UDRE interrupt */
         UART0_CONTROL &= ~_BV(UART0_UDRIE);
     }
+    ISRSTAT_EXIT(ISRSTAT_UART_UDRE);
 }
 
 
@@ -438,10 +538,21 @@ ISR(UART0_TRANSMIT_INTERRUPT)
  **************************************************************************/
 void uart_init(unsigned int baudrate)
 {
-    UART_TxHead = 0;
-    UART_TxTail = 0;
-    UART_RxHead = 0;
-    UART_RxTail = 0;
+    uart_tx_ring_init(&UART_TxRing);
+    uart_rx_ring_init(&UART_RxRing);
+    #if UART_RX_LINE_MODE
+    UART_LineFill    = 0;
+    UART_LineLen     = 0;
+    UART_LineReady   = 0;
+    UART_LinePending = 0;
+    UART_LineHeld    = 0;
+    #endif
+    #if UART_TX_PINGPONG
+    UART_PpFill      = 0;
+    UART_PpLen[0]    = 0;
+    UART_PpLen[1]    = 0;
+    UART_PpOverruns  = 0;
+    #endif
 
     #ifdef UART_TEST
     # ifndef UART0_BIT_U2X
@@ -467,8 +578,14 @@ void uart_init(unsigned int baudrate)
         UART0_STATUS = (1 << UART0_BIT_U2X); // Enable 2x speed
         #endif
     }
+    #if UART0_BIT_U2X
+    else
+    {
+        UART0_STATUS = 0; // Normal speed, bootloader may leave U2X set
+    }
+    #endif
     #if defined(UART0_UBRRH)
-    UART0_UBRRH = (unsigned char) ((baudrate >> 8) & 0x80);
+    UART0_UBRRH = (unsigned char) ((baudrate >> 8) & 0x0F);
     #endif
     UART0_UBRRL = (unsigned char) (baudrate & 0x00FF);
 
@@ -493,30 +610,60 @@ void uart_init(unsigned int baudrate)
  **************************************************************************/
 unsigned int uart_getc(void)
 {
-    unsigned char tmptail;
     unsigned char data;
     unsigned char lastRxError;
 
 
-    if (UART_RxHead == UART_RxTail)
+    /* get data from receive buffer */
+    if (!uart_rx_ring_pop(&UART_RxRing, &data))
     {
         return UART_NO_DATA; /* no data available */
     }
-
-    /* calculate buffer index */
-    tmptail = (UART_RxTail + 1) & UART_RX_BUFFER_MASK;
-
-    /* get data from receive buffer */
-    data        = UART_RxBuf[tmptail];
     lastRxError = UART_LastRxError;
 
-    /* store buffer index */
-    UART_RxTail = tmptail;
-
     UART_LastRxError = 0;
     return (lastRxError << 8) + data;
 }/* uart_getc */
 
+#if UART_RX_LINE_MODE
+/*************************************************************************
+ * Function: uart_getline()
+ * Purpose:  return next complete line received by UART
+ * Returns:  line without terminator, valid until the next call,
+ *           NULL if no complete line is available
+ **************************************************************************/
+char *uart_getline(void)
+{
+    char *line = NULL;
+
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (UART_LineHeld)
+        {
+            /* the caller is done with the previous line */
+            UART_LineHeld  = 0;
+            UART_LineReady = 0;
+            if (UART_LinePending)
+            {
+                /* line waiting in the other buffer, swap buffers now */
+                UART_LinePending = 0;
+                UART_LineFill   ^= 1;
+                UART_LineLen     = 0;
+                UART_LineReady   = 1;
+            }
+        }
+        if (UART_LineReady)
+        {
+            UART_LineHeld = 1;
+            line = UART_LineBuf[UART_LineFill ^ 1];
+        }
+    }
+    return line;
+}/* uart_getline */
+
+#endif
+
 /*************************************************************************
  * Function: uart_putc()
  * Purpose:  write byte to ringbuffer for transmitting via UART
@@ -525,22 +672,186 @@ unsigned int uart_getc(void)
  **************************************************************************/
 void uart_putc(unsigned char data)
 {
-    unsigned char tmphead;
+    #if UART_TX_POLICY == UART_TX_DROP
+    if (!uart_tx_ring_push(&UART_TxRing, data))
+    {
+        /* buffer full, discard new byte */
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            UART_TxDropped++;
+        }
+        return;
+    }
+    #elif UART_TX_POLICY == UART_TX_OVERWRITE
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (uart_tx_ring_space(&UART_TxRing) == 0)
+        {
+            /* buffer full, discard oldest byte not sent yet, the
+               interrupt is the consumer and cannot run meanwhile */
+            uart_tx_ring_drop(&UART_TxRing);
+            UART_TxDropped++;
+        }
+    }
+    uart_tx_ring_push(&UART_TxRing, data);
+    #else
+    while (!uart_tx_ring_push(&UART_TxRing, data))
+    {
+        ;/* wait for free space in buffer */
+    }
+    #endif
+
+    /* enable UDRE interrupt */
+    UART0_CONTROL |= _BV(UART0_UDRIE);
+}/* uart_putc */
+
+/*************************************************************************
+ * Function: uart_tx_dropped()
+ * Purpose:  return and clear number of discarded transmit bytes
+ * Returns:  number of bytes discarded since the last call
+ **************************************************************************/
+unsigned int uart_tx_dropped(void)
+{
+    unsigned int dropped = 0;
 
+    #if UART_TX_POLICY != UART_TX_BLOCK
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        dropped        = UART_TxDropped;
+        UART_TxDropped = 0;
+    }
+    #endif
+    return dropped;
+}/* uart_tx_dropped */
 
-    tmphead = (UART_TxHead + 1) & UART_TX_BUFFER_MASK;
+/*************************************************************************
+ * Function: uart_write_nb()
+ * Purpose:  copy as many bytes as fit into ringbuffer, do not wait
+ * Input:    buffer and number of bytes to be transmitted
+ * Returns:  number of bytes written to ringbuffer
+ **************************************************************************/
+unsigned int uart_write_nb(const void *buf, unsigned int len)
+{
+    /* the buffer holds at most 255 bytes, all bytes are published at once */
+    len = uart_tx_ring_write(&UART_TxRing, buf, (len > 255) ? 255 : len);
 
-    while (tmphead == UART_TxTail)
+    if (len)
     {
-        ;/* wait for free space in buffer */
+        /* enable UDRE interrupt */
+        UART0_CONTROL |= _BV(UART0_UDRIE);
+    }
+    return len;
+}/* uart_write_nb */
+
+/*************************************************************************
+ * Function: uart_write()
+ * Purpose:  write block of bytes to ringbuffer for transmitting via UART
+ * Input:    buffer and number of bytes to be transmitted
+ * Returns:  none
+ **************************************************************************/
+void uart_write(const void *buf, unsigned int len)
+{
+    const unsigned char *p = buf;
+    unsigned int n;
+
+
+    while (len)
+    {
+        /* wait for free space in buffer */
+        n    = uart_write_nb(p, len);
+        p   += n;
+        len -= n;
+
+        #if UART_TX_POLICY == UART_TX_DROP
+        if (len)
+        {
+            /* buffer full, discard the rest of the block */
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                UART_TxDropped += len;
+            }
+            break;
+        }
+        #elif UART_TX_POLICY == UART_TX_OVERWRITE
+        if (len)
+        {
+            /* buffer full, make room by discarding the oldest byte */
+            uart_putc(*p++);
+            len--;
+        }
+        #endif
+    }
+}/* uart_write */
+
+#if UART_TX_PINGPONG
+/*************************************************************************
+ * Function: uart_pp_buffer()
+ * Purpose:  return ping-pong buffer being filled by the producer
+ * Returns:  buffer of UART_PP_BUFFER_SIZE bytes
+ **************************************************************************/
+unsigned char *uart_pp_buffer(void)
+{
+    return UART_PpBuf[UART_PpFill];
+}/* uart_pp_buffer */
+
+/*************************************************************************
+ * Function: uart_pp_swap()
+ * Purpose:  pass filled buffer to transmit interrupt and get the other one
+ * Input:    number of bytes in the filled buffer
+ * Returns:  buffer to be filled next
+ **************************************************************************/
+unsigned char *uart_pp_swap(unsigned char len)
+{
+    unsigned char fill = UART_PpFill;
+
+
+    if (len == 0)
+    {
+        return UART_PpBuf[fill];
     }
 
-    UART_TxBuf[tmphead] = data;
-    UART_TxHead         = tmphead;
+    if (UART_PpLen[fill ^ 1])
+    {
+        /* previous block not sent yet, discard this one and refill it */
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            UART_PpOverruns++;
+        }
+        return UART_PpBuf[fill];
+    }
+
+    if (len > UART_PP_BUFFER_SIZE)
+        len = UART_PP_BUFFER_SIZE;
+
+    /* the interrupt sees the block only after UART_PpFill is switched */
+    UART_PpPos       = 0;
+    UART_PpLen[fill] = len;
+    UART_PpFill      = fill ^ 1;
 
     /* enable UDRE interrupt */
     UART0_CONTROL |= _BV(UART0_UDRIE);
-}/* uart_putc */
+
+    return UART_PpBuf[fill ^ 1];
+}/* uart_pp_swap */
+
+/*************************************************************************
+ * Function: uart_pp_overruns()
+ * Purpose:  return and clear number of discarded ping-pong blocks
+ * Returns:  number of blocks discarded since the last call
+ **************************************************************************/
+unsigned int uart_pp_overruns(void)
+{
+    unsigned int overruns;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        overruns       = UART_PpOverruns;
+        UART_PpOverruns = 0;
+    }
+    return overruns;
+}/* uart_pp_overruns */
+
+#endif
 
 /*************************************************************************
  * Function: uart_puts()
@@ -550,8 +861,7 @@ void uart_putc(unsigned char data)
  **************************************************************************/
 void uart_puts(const char *s)
 {
-    while (*s)
-        uart_putc(*s++);
+    uart_write(s, strlen(s));
 }/* uart_puts */
 
 /*************************************************************************
@@ -580,7 +890,6 @@ ISR(UART1_RECEIVE_INTERRUPT)
  * Purpose:  called when the UART1 has received a character
  **************************************************************************/
 {
-    unsigned char tmphead;
     unsigned char data;
     unsigned char usr;
     unsigned char lastRxError;
@@ -593,21 +902,12 @@ ISR(UART1_RECEIVE_INTERRUPT)
     /* get FEn (Frame Error) DORn (Data OverRun) UPEn (USART Parity Error) bits */
     lastRxError = usr & (_BV(FE1) | _BV(DOR1) | _BV(UPE1) );
 
-    /* calculate buffer index */
-    tmphead = ( UART1_RxHead + 1) & UART_RX_BUFFER_MASK;
-
-    if (tmphead == UART1_RxTail)
+    /* store received data in buffer */
+    if (!uart_rx_ring_push(&UART1_RxRing, data))
     {
         /* error: receive buffer overflow */
         lastRxError = UART_BUFFER_OVERFLOW >> 8;
     }
-    else
-    {
-        /* store new index */
-        UART1_RxHead = tmphead;
-        /* store received data in buffer */
-        UART1_RxBuf[tmphead] = data;
-    }
     UART1_LastRxError |= lastRxError;
 }
 
@@ -619,16 +919,13 @@ ISR(UART1_TRANSMIT_INTERRUPT)
  * Purpose:  called when the UART1 is ready to transmit the next byte
  **************************************************************************/
 {
-    unsigned char tmptail;
+    unsigned char data;
 
 
-    if (UART1_TxHead != UART1_TxTail)
+    if (uart_tx_ring_pop(&UART1_TxRing, &data))
     {
-        /* calculate and store new buffer index */
-        tmptail      = (UART1_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART1_TxTail = tmptail;
         /* get one byte from buffer and write it to UART */
-        UART1_DATA = UART1_TxBuf[tmptail]; /* start transmission */
+        UART1_DATA = data; /* start transmission */
     }
     else
     {
@@ -646,10 +943,8 @@ ISR(UART1_TRANSMIT_INTERRUPT)
  **************************************************************************/
 void uart1_init(unsigned int baudrate)
 {
-    UART1_TxHead = 0;
-    UART1_TxTail = 0;
-    UART1_RxHead = 0;
-    UART1_RxTail = 0;
+    uart_tx_ring_init(&UART1_TxRing);
+    uart_rx_ring_init(&UART1_RxRing);
 
     # ifdef UART_TEST
     #  ifndef UART1_BIT_U2X
@@ -697,26 +992,17 @@ void uart1_init(unsigned int baudrate)
  **************************************************************************/
 unsigned int uart1_getc(void)
 {
-    unsigned char tmptail;
-    unsigned int data;
+    unsigned char data;
     unsigned char lastRxError;
 
 
-    if (UART1_RxHead == UART1_RxTail)
+    /* get data from receive buffer */
+    if (!uart_rx_ring_pop(&UART1_RxRing, &data))
     {
         return UART_NO_DATA; /* no data available */
     }
-
-    /* calculate buffer index */
-    tmptail = (UART1_RxTail + 1) & UART_RX_BUFFER_MASK;
-
-    /* get data from receive buffer */
-    data        = UART1_RxBuf[tmptail];
     lastRxError = UART1_LastRxError;
 
-    /* store buffer index */
-    UART1_RxTail = tmptail;
-
     UART1_LastRxError = 0;
     return (lastRxError << 8) + data;
 }/* uart1_getc */
@@ -729,19 +1015,11 @@ unsigned int uart1_getc(void)
  **************************************************************************/
 void uart1_putc(unsigned char data)
 {
-    unsigned char tmphead;
-
-
-    tmphead = (UART1_TxHead + 1) & UART_TX_BUFFER_MASK;
-
-    while (tmphead == UART1_TxTail)
+    while (!uart_tx_ring_push(&UART1_TxRing, data))
     {
         ;/* wait for free space in buffer */
     }
 
-    UART1_TxBuf[tmphead] = data;
-    UART1_TxHead         = tmphead;
-
     /* enable UDRE interrupt */
     UART1_CONTROL |= _BV(UART1_UDRIE);
 }/* uart1_putc */
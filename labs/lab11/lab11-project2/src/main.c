@@ -2,15 +2,16 @@
 #include <avr/interrupt.h>  // Interrupts standard C library for AVR-GCC
 #include <gpio.h>           // GPIO library for AVR-GCC
 #include "timer.h"          // Timer library for AVR-GCC
-#include <stdlib.h>         // C library. Needed for number conversions
 #include <lcd.h>            // Peter Fleury's LCD library
-#include <util/delay.h>     // Functions for busy-wait delay loops
-#include <string.h>         // Standard library for strings
+#include <lcd_fb.h>         // Frame buffer layer for LCD library
+#include <format.h>         // Integer number formatting
+#include <adc.h>            // Auto-triggered ADC sampling
 
 #define SW   PD2            // Pin D2  - Digital pin for button on Joystick
 #define LED  PB5            // Pin D13 - LED indicate
 #define PINX PC0            // Pin A0  - Analog pin for X coordinate of Joystick
 #define PINY PC1            // Pin A1  - Analog pin for Y coordinate of Joystick
+#define SERVO_HOLD 1        // Ticks (33 ms) to skip after each update to let servos process the command
 
 //PWM limit values
 const uint16_t min_servo_v = 16; // min PWM value for vertical servo
@@ -26,6 +27,13 @@ const uint16_t max_h_servo_angle = 180; // max angle of horizontal servo in deeg
 uint16_t servo_v;                 // PWM value variable for vartical servo
 uint16_t servo_h;                 // PWM value variable for horizontal servo
 
+volatile uint8_t tick = 0;        // Set by Timer1 overflow every 33 ms, cleared by main loop
+
+const uint8_t joystick[2] = {PINX, PINY}; // ADC channels of X and Y coordinates, ADC0 and ADC1
+
+/* Function prototypes -----------------------------------------------*/
+void joystick_update(uint16_t x, uint16_t y);
+
 /**********************************************************************
  * Function: convertAngleToDeegrees()
  * Purpose:  Convert value in PWM to angle in deegrees.
@@ -40,16 +48,15 @@ uint16_t convertAngleToDeegrees(uint16_t PWM_value, uint16_t PWM_min_value, uint
 {
     uint16_t countOfSteps;          // available count of PWM steps
     int16_t actualPWMValue;         // actual PWM step
-    float oneStepAngle;             // angle of one PWM step
-    float convertedAngle;           // converted PWM step to angle
+    uint16_t convertedAngle;        // converted PWM step to angle
 
     countOfSteps = PWM_max_value - PWM_min_value;
-    oneStepAngle = (float) max_angle_of_servo / (float) countOfSteps;
     actualPWMValue = PWM_value - PWM_min_value;
 
-    if (actualPWMValue >= 0 && actualPWMValue <= PWM_max_value)
+    if (actualPWMValue >= 0 && actualPWMValue <= (int16_t) countOfSteps)
     {
-        convertedAngle = (float) actualPWMValue * oneStepAngle;
+        // angle = step * max_angle / steps, rounded to the nearest deegree
+        convertedAngle = ((uint16_t) actualPWMValue * max_angle_of_servo + countOfSteps / 2) / countOfSteps;
     }
     else if (actualPWMValue < 0)
     {
@@ -59,7 +66,7 @@ uint16_t convertAngleToDeegrees(uint16_t PWM_value, uint16_t PWM_min_value, uint
     {
         convertedAngle = max_angle_of_servo;
     }       
-    return (uint16_t) round(convertedAngle);
+    return convertedAngle;
 }
 
 /* Main function -----------------------------------------------------*/
@@ -80,31 +87,19 @@ int main(void)
 
     // Initialize LCD display without any cursor
     lcd_init(LCD_DISP_ON);                          
-    lcd_gotoxy(0,0);
+    lcd_fb_init();
 
     // Primary inscription on the LCD
-    lcd_puts("ANGLE V: 0 deg");
-    lcd_gotoxy(0,1);
-    lcd_puts("ANGLE H: 0 deg");
+    lcd_fb_puts(0, 0, "ANGLE V:   0 deg");
+    lcd_fb_puts(0, 1, "ANGLE H:   0 deg");
 
     // Configure Analog-to-Digital Convertion unit
-    // Select ADC voltage reference to "AVcc with external capacitor at AREF pin"
-    ADMUX |=  (1<<REFS0); 
-    ADMUX &= ~(1<<REFS1);       
-
-    // Select input channel ADC0 (voltage divider pin)
-    ADMUX &= ~((1<<MUX3) | (1<<MUX2) | (1<<MUX1) | (1<<MUX0));        
-
-    // Enable ADC module
-    ADCSRA |= (1<<ADEN);
-
-    // Enable conversion complete interrupt
-    ADCSRA |= (1<<ADIE);
+    // Convert X and Y coordinates in turn, 500 samples per second of each,
+    // AVcc reference, prescaler 128. Conversions are started by
+    // Timer/Counter0 compare match in hardware, no interrupt is used
+    adc_init_rate(joystick, 2, 500);
 
-    // Set clock prescaler to 128
-    ADCSRA |= ((1<<ADPS0) | (1<<ADPS1) | (1<<ADPS2));    
-    
-    // Configure 16-bit Timer/Counter1 to start ADC conversion
+    // Configure 16-bit Timer/Counter1 to update servos
     // Enable overflow interrupt                      
     TIM1_overflow_interrupt_enable(); 
 
@@ -125,10 +120,38 @@ int main(void)
     // Enables interrupts by setting the global interrupt mask
     sei();
     
+    uint32_t sum[2] = {0, 0};                       // Sum of samples since the last update
+    uint16_t count[2] = {0, 0};                     // Number of samples since the last update
+    uint16_t mean[2] = {512, 512};                  // Neutral position of joystick until the first samples
+    uint16_t value;
+    uint8_t i;
+
     // Infinite loop
     while (1)       
     {          
-    // All actions are performed in this loop    
+        for (i = 0; i < 2; i++)                     // Empty ring buffers of both coordinates
+        {
+            while (adc_get(i, &value))
+            {
+                sum[i] += value;
+                count[i]++;
+            }
+        }
+
+        if (tick)                                   // Every 33 ms use the mean of collected samples
+        {
+            tick = 0;
+            for (i = 0; i < 2; i++)
+            {
+                if (count[i] != 0)
+                    mean[i] = sum[i] / count[i];
+                sum[i] = 0;
+                count[i] = 0;
+            }
+            joystick_update(mean[0], mean[1]);
+        }
+
+        lcd_fb_flush();                             // Send changed characters to LCD, only main loop writes to the frame buffer
     }
 
     // Will never reach this
@@ -138,117 +161,94 @@ int main(void)
 /* Interrupt service routines ----------------------------------------*/
 /**********************************************************************
  * Function: Timer/Counter1 overflow interrupt
- * Purpose:  Use single conversion mode and start conversion every 100 ms.
+ * Purpose:  Let main loop update servos once per PWM period (33 ms).
  **********************************************************************/
 
 ISR(TIMER1_OVF_vect)
 {
-    ADCSRA |= (1<<ADSC);                             // Start ADC conversion                                    
+    tick = 1;
 }
 
+/* Function definitions ----------------------------------------------*/
 /**********************************************************************
- * Function: ADC complete interrupt
- * Purpose:  Display converted value on LCD screen.
+ * Function: joystick_update()
+ * Purpose:  Move servos by joystick position and display their angles.
+ * Input(s): x - Mean ADC value of X coordinate since the last call
+ *           y - Mean ADC value of Y coordinate since the last call
+ * Returns:  none
  **********************************************************************/
-
-ISR(ADC_vect)
+void joystick_update(uint16_t x, uint16_t y)
 {
+    static uint8_t hold = 0;                        // Ticks to skip before the next update
+
+    if (hold)                                       // Servos still process the last command, no busy wait
+    {
+        hold--;
+        return;
+    }
+
     GPIO_read(&PIND, SW);                           // Reading data from Joystick Button
     GPIO_read(&PINC, PINX);                         // Reading value (voltage) from Joystick X coordinate
     GPIO_read(&PINC, PINY);                         // Reading value (voltage) from Joystick Y coordinate
     GPIO_write_low(&PORTB, LED);                    // Turning off LED port or low level
         
     uint16_t value;                                 // Constant which shows 2 direction for ADC (0-1024)          | uint16_t range is 0 to 32 767
-    char angle[3];                                  // Constant which shows angle string on LCD
     
     if (!GPIO_read(&PIND, SW))                      // Joystick button reading condition
     {
         GPIO_write_high(&PORTB, LED);               // Turning on the LED (just indicate that button is pressed)
-        lcd_gotoxy(9,0);                            // show vertical angle on LCD
-        lcd_puts("       ");
-        lcd_gotoxy(9,0);
         servo_v = 45;
-        itoa(convertAngleToDeegrees(servo_v, min_servo_v, max_servo_v, min_v_servo_angle, max_v_servo_angle), angle, 10);
-        lcd_puts(strcat(angle, " deg"));
-        lcd_gotoxy(9,1);                            // show horizontal angle on LCD
-        lcd_puts("       ");
-        lcd_gotoxy(9,1);
+        fmt_dec(lcd_fb_ptr(9, 0), convertAngleToDeegrees(servo_v, min_servo_v, max_servo_v, min_v_servo_angle, max_v_servo_angle), 3);  // show vertical angle on LCD
         servo_h = 45;
-        itoa(convertAngleToDeegrees(servo_h, min_servo_h, max_servo_h, min_h_servo_angle, max_h_servo_angle), angle, 10);
-        lcd_puts(strcat(angle, " deg"));
+        fmt_dec(lcd_fb_ptr(9, 1), convertAngleToDeegrees(servo_h, min_servo_h, max_servo_h, min_h_servo_angle, max_h_servo_angle), 3);  // show horizontal angle on LCD
     }
 
-    switch (ADMUX)                                  // Important condition, which needs to define ports between ADC0 and ADC1 for ADC Conversion (it's all a last digit) 
+    // X coordinate, channel ADC0, vertical servo
+    value = x;
+    if (value > 900)                                // Condition if we are moving to the Right side on LCD
     {
-        case 0b01000000:                            // Turning on the port ADC0 that has amount 0100 0000        
-        value = ADC;                                // Read converted value            
-        if (value > 900)                            // Condition if we are moving to the Right side on LCD
-        {
-            GPIO_write_high(&PORTB, LED);           // Turning on the LED
+        GPIO_write_high(&PORTB, LED);               // Turning on the LED
 
-            if(servo_v < max_servo_v)               // increase angle of vertical servo
-            {
-                lcd_gotoxy(9,0);                    // show vertical angle on LCD
-                lcd_puts("       ");
-                lcd_gotoxy(9,0);
-                servo_v++;
-                itoa(convertAngleToDeegrees(servo_v, min_servo_v, max_servo_v, min_v_servo_angle, max_v_servo_angle), angle, 10);
-                lcd_puts(strcat(angle, " deg"));                                        
-            }
-        }
-        if (value < 100)                            
+        if(servo_v < max_servo_v)                   // increase angle of vertical servo
         {
-            GPIO_write_high(&PORTB, LED);           // Turning on the LED
+            servo_v++;
+            fmt_dec(lcd_fb_ptr(9, 0), convertAngleToDeegrees(servo_v, min_servo_v, max_servo_v, min_v_servo_angle, max_v_servo_angle), 3);  // show vertical angle on LCD
+        }
+    }
+    if (value < 100)                            
+    {
+        GPIO_write_high(&PORTB, LED);               // Turning on the LED
 
-            if(servo_v > min_servo_v)               // decrease angle of vertical servo
-            {
-                lcd_gotoxy(9,0);                    // show vertical angle on LCD
-                lcd_puts("       ");
-                lcd_gotoxy(9,0);
-                servo_v--;
-                itoa(convertAngleToDeegrees(servo_v, min_servo_v, max_servo_v, min_v_servo_angle, max_v_servo_angle), angle, 10);
-                lcd_puts(strcat(angle, " deg"));                                        
-            }            
+        if(servo_v > min_servo_v)                   // decrease angle of vertical servo
+        {
+            servo_v--;
+            fmt_dec(lcd_fb_ptr(9, 0), convertAngleToDeegrees(servo_v, min_servo_v, max_servo_v, min_v_servo_angle, max_v_servo_angle), 3);  // show vertical angle on LCD
+        }            
+    }
+        
+    // Y coordinate, channel ADC1, horizontal servo
+    value = y;
+    if (value > 900)                            
+    {
+        GPIO_write_high(&PORTB, LED);               // Turning on the LED
+        
+        if(servo_h < max_servo_h)                   // increase angle of horizontal servo
+        {
+            servo_h++;
+            fmt_dec(lcd_fb_ptr(9, 1), convertAngleToDeegrees(servo_h, min_servo_h, max_servo_h, min_h_servo_angle, max_h_servo_angle), 3);  // show horizontal angle on LCD
         }
-        ADMUX = 0b01000001;                         // At the end of the loop, change port ADC0 to ADC1            
-        break;                                      // Stop the first condition of CASE
-            
-        case 0b01000001:                            // Turning on the port ADC1 that has amount 0100 0001
-        value = ADC;                                // Read converted value
-        if (value > 900)                            
+    }
+    if (value < 100)
+    {   GPIO_write_high(&PORTB, LED);               // Turning on the LED
+        
+        if(servo_h > min_servo_h)                   // decrease angle of horizontal servo
         {
-            GPIO_write_high(&PORTB, LED);           // Turning on the LED
-            
-            if(servo_h < max_servo_h)               // increase angle of horizontal servo
-            {
-                lcd_gotoxy(9,1);                    // show horizontal angle on LCD
-                lcd_puts("       ");
-                lcd_gotoxy(9,1);
-                servo_h++;
-                itoa(convertAngleToDeegrees(servo_h, min_servo_h, max_servo_h, min_h_servo_angle, max_h_servo_angle), angle, 10);
-                lcd_puts(strcat(angle, " deg"));                                        
-            }
+            servo_h--;
+            fmt_dec(lcd_fb_ptr(9, 1), convertAngleToDeegrees(servo_h, min_servo_h, max_servo_h, min_h_servo_angle, max_h_servo_angle), 3);  // show horizontal angle on LCD
         }
-        if (value < 100)
-        {   GPIO_write_high(&PORTB, LED);           // Turning on the LED
-            
-            if(servo_h > min_servo_h)               // decrease angle of horizontal servo
-            {
-                lcd_gotoxy(9,1);                    // show horizontal angle on LCD
-                lcd_puts("       ");
-                lcd_gotoxy(9,1);
-                servo_h--;
-                itoa(convertAngleToDeegrees(servo_h, min_servo_h, max_servo_h, min_h_servo_angle, max_h_servo_angle), angle, 10);
-                lcd_puts(strcat(angle, " deg"));                                        
-            }
-        }        
-        ADMUX = 0b01000000;                         // Again change port from ADC1 to ADC0
-        break;                                      // Stop the second condition of CASE
+    }        
 
-        default:                                    // Each case should have the default condition which is empty
-        break;
-    }
-        OCR1A = servo_v;                            // generate PWM for vertical servo
-        OCR1B = servo_h;                            // generate PWM for horizontal servo
-        _delay_ms(50);                              // wait to servo process the command 
+    OCR1A = servo_v;                                // generate PWM for vertical servo
+    OCR1B = servo_h;                                // generate PWM for horizontal servo
+    hold = SERVO_HOLD;                              // wait to servo process the command
 }
\ No newline at end of file
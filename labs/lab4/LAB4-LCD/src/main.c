@@ -31,6 +31,7 @@
 #include <gpio.h>           // GPIO library for AVR-GCC
 #include "timer.h"          // Timer library for AVR-GCC
 #include <lcd.h>            // Peter Fleury's LCD library
+#include <lcd_fb.h>         // Frame buffer layer for LCD library
 #include <stdlib.h>         // C library. Needed for number conversions
 
 
@@ -38,18 +39,18 @@
 /**********************************************************************
  * Function: Main function where the program execution begins
  * Purpose:  Update stopwatch value on LCD screen when 8-bit 
- *           Timer/Counter2 overflows.
+ *           Timer/Counter2 overflows. The interrupt writes the frame
+ *           buffer, the loop sends its changed characters to LCD.
  * Returns:  none
  **********************************************************************/
 int main(void)
 {
     // Initialize display
     lcd_init(LCD_DISP_ON_CURSOR_BLINK);
+    lcd_fb_init();
 
     // Put string(s) on LCD screen
-    lcd_gotoxy(6, 1);
-    lcd_puts("LCD Test");
-    lcd_putc('!');
+    lcd_fb_puts(6, 1, "LCD Test!");
 
 
     // Configuration of 8-bit Timer/Counter2 for Stopwatch update
@@ -63,8 +64,9 @@ int main(void)
     // Infinite loop
     while (1)
     {
-        /* Empty loop. All subsequent operations are performed exclusively 
-         * inside interrupt service routines, ISRs */
+        /* Stopwatch is updated inside interrupt service routine, ISR,
+         * in RAM only. Send the changed characters to LCD here */
+        lcd_fb_flush();
     }
 
     // Will never reach this
@@ -82,7 +84,7 @@ ISR(TIMER2_OVF_vect)
 {
     static uint8_t no_of_overflows = 0;
     static uint8_t tenths = 0;  // Tenths of a second
-    char string[2];             // String for converted numbers by itoa()
+    char string[3];             // String for converted numbers by itoa()
 
     no_of_overflows++;
     if (no_of_overflows >= 6)
@@ -99,17 +101,9 @@ ISR(TIMER2_OVF_vect)
         }
 
         itoa(tenths, string, 10);  // Convert decimal value to string
-        // Display "00:00.tenths"
-        lcd_gotoxy(1, 0);
-        lcd_puts("00");
-        lcd_gotoxy(3, 0);
-        lcd_putc(':');
-         lcd_gotoxy(4, 0);
-        lcd_puts("00");
-        lcd_gotoxy(6, 0);
-        lcd_putc('.');
-        lcd_gotoxy(8, 0);
-        lcd_puts(string);
+        // Display "00:00.tenths", flushed to LCD by main loop
+        lcd_fb_puts(1, 0, "00:00.");
+        lcd_fb_puts(8, 0, string);
     }
     // Else do nothing and exit the ISR
 }
\ No newline at end of file
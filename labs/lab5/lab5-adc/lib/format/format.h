@@ -0,0 +1,94 @@
+#ifndef FORMAT_H
+# define FORMAT_H
+
+/***********************************************************************
+ *
+ * Integer number formatting for LCD and UART output.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @defgroup format Number Formatting <format.h>
+ * @code #include <format.h> @endcode
+ *
+ * @brief Integer-only number formatting for LCD and UART output.
+ *
+ * Replacement for itoa(), strcat() and float arithmetic in interrupt
+ * service routines. Functions write the characters directly to the
+ * destination, e.g. LCD frame buffer cell lcd_fb_ptr(x, y) or a UART
+ * string, and never write the terminating null character. They return
+ * pointer behind the last written character, so several fields can be
+ * chained and the string terminated by the caller:
+ * @code
+ * char *p = fmt_dec(string, value, 4);
+ * *p = '\0';
+ * uart_puts(string);
+ * @endcode
+ *
+ * With nonzero width, the field has always exactly width characters
+ * and number is right aligned. Number which does not fit is replaced
+ * by '#' characters, so the field never overflows. With width 0 only
+ * the necessary characters are written.
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/io.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define FMT_DECIMALS_MAX 4  /**< @brief Maximal number of decimal places of fmt_fixed() */
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Write unsigned decimal number padded by spaces.
+ * @param  buf   Destination
+ * @param  value Number to be written
+ * @param  width Field width, 0 for no padding
+ * @return Pointer behind the last written character
+ */
+char *fmt_dec(char *buf, uint16_t value, uint8_t width);
+
+
+/**
+ * @brief  Write signed fixed-point number, e.g. value 3300 with two
+ *         decimal places is written as "33.00".
+ * @param  buf      Destination
+ * @param  value    Number scaled by 10^decimals
+ * @param  width    Field width, 0 for no padding
+ * @param  decimals Number of decimal places, 0 to FMT_DECIMALS_MAX
+ * @return Pointer behind the last written character
+ */
+char *fmt_fixed(char *buf, int16_t value, uint8_t width, uint8_t decimals);
+
+
+/**
+ * @brief  Write hexadecimal number with leading zeros.
+ * @param  buf    Destination
+ * @param  value  Number to be written
+ * @param  digits Number of digits, 1 to 4
+ * @return Pointer behind the last written character
+ */
+char *fmt_hex(char *buf, uint16_t value, uint8_t digits);
+
+
+/**
+ * @brief  Write binary number with leading zeros.
+ * @param  buf    Destination
+ * @param  value  Number to be written
+ * @param  digits Number of digits, 1 to 16
+ * @return Pointer behind the last written character
+ */
+char *fmt_bin(char *buf, uint16_t value, uint8_t digits);
+
+
+/** @} */
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef LCD_FB_H
+# define LCD_FB_H
+
+/***********************************************************************
+ * 
+ * Frame buffer layer for Peter Fleury's HD44780U LCD library.
+ * 
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file 
+ * @defgroup lcd_fb LCD Frame Buffer <lcd_fb.h>
+ * @code #include <lcd_fb.h> @endcode
+ *
+ * @brief Frame buffer layer for HD44780U LCD library.
+ *
+ * The application writes characters into RAM buffer lcd_fb, either by
+ * functions of this module or directly through lcd_fb_ptr(). Function
+ * lcd_fb_flush() compares the buffer with the copy of what is already
+ * shown on the display and sends only the changed cells. Contiguous
+ * runs of changed cells on one line are sent after a single DDRAM
+ * address set.
+ *
+ * Size of the buffer follows LCD_LINES and LCD_DISP_LENGTH from
+ * lcd_definitions.h, i.e. 16x2 and 20x4 displays are supported.
+ *
+ * @note lcd_fb_flush() must not be interrupted by other functions of
+ *       LCD library, e.g. called from ISR.
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <lcd.h>
+
+
+/* Defines -----------------------------------------------------------*/
+/** @brief Pointer to frame buffer cell at position x, y */
+#define lcd_fb_ptr(x, y) (&lcd_fb[(y)][(x)])
+
+
+/* Variables ---------------------------------------------------------*/
+/** @brief Frame buffer, one character per display cell */
+extern char lcd_fb[LCD_LINES][LCD_DISP_LENGTH];
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Clear display and frame buffer.
+ * @return none
+ * @note   Call it after lcd_init() and before the first lcd_fb_flush().
+ */
+void lcd_fb_init(void);
+
+
+/**
+ * @brief  Fill frame buffer with spaces. The display is not changed
+ *         until lcd_fb_flush() is called.
+ * @return none
+ */
+void lcd_fb_clear(void);
+
+
+/**
+ * @brief  Write one character to frame buffer.
+ * @param  x Horizontal position (0: left most position)
+ * @param  y Vertical position (0: first line)
+ * @param  c Character to be displayed
+ * @return none
+ */
+void lcd_fb_putc(uint8_t x, uint8_t y, char c);
+
+
+/**
+ * @brief  Write string to frame buffer, characters behind the end of
+ *         the line are discarded.
+ * @param  x Horizontal position (0: left most position)
+ * @param  y Vertical position (0: first line)
+ * @param  s String to be displayed
+ * @return Horizontal position behind the last written character
+ */
+uint8_t lcd_fb_puts(uint8_t x, uint8_t y, const char *s);
+
+
+/**
+ * @brief  Send changed cells of frame buffer to the display.
+ * @return Number of characters sent to the display
+ */
+uint8_t lcd_fb_flush(void);
+
+
+/** @} */
+
+#endif
@@ -18,43 +18,42 @@
 #include <gpio.h>           // GPIO library for AVR-GCC
 #include "timer.h"          // Timer library for AVR-GCC
 #include <lcd.h>            // Peter Fleury's LCD library
-#include <stdlib.h>         // C library. Needed for number conversions
+#include <lcd_fb.h>         // Frame buffer layer for LCD library
+#include <format.h>         // Integer number formatting
+#include <adc.h>            // Auto-triggered ADC sampling
 
 
 /* Function definitions ----------------------------------------------*/
 /**********************************************************************
  * Function: Main function where the program execution begins
- * Purpose:  Use Timer/Counter1 and start ADC conversion every 100 ms.
- *           When AD conversion ends, send converted value to LCD screen.
+ * Purpose:  Let Timer/Counter1 start ADC conversion 30 times per second.
+ *           When a new converted value is available, write it to the
+ *           frame buffer and send the changed characters to LCD screen.
  * Returns:  none
  **********************************************************************/
 int main(void)
 {
+    static const uint8_t keypad = 0;  // Input channel ADC0 (voltage divider pin)
+    uint16_t value;  // 12-bit sample, ADC_OVERSAMPLE in platformio.ini
+    uint16_t key;    // Sample reduced to 10 bits for key thresholds
+    const char *name;  // Button name
+
     // Initialize display
     lcd_init(LCD_DISP_ON);
-    lcd_gotoxy(1, 0); lcd_puts("value:");
-    lcd_gotoxy(1, 1); lcd_puts("key:");
-    lcd_gotoxy(8, 0); lcd_puts("a");  // Put ADC value in decimal
-    lcd_gotoxy(13,0); lcd_puts("b");  // Put ADC value in hexadecimal
-    lcd_gotoxy(6, 1); lcd_puts("c");  // Put button name here
+    lcd_fb_init();
+    lcd_fb_puts(1, 0, "value:");
+    lcd_fb_puts(1, 1, "key:");
+    lcd_fb_puts(8, 0, "a");  // Put ADC value in decimal
+    lcd_fb_puts(13,0, "b");  // Put ADC value in hexadecimal
+    lcd_fb_puts(6, 1, "c");  // Put button name here
+    lcd_fb_flush();
 
     // Configure Analog-to-Digital Convertion unit
-    // Select ADC voltage reference to "AVcc with external capacitor at AREF pin"
-    ADMUX |= (1<<REFS0);
-    ADMUX &= ~(1<<REFS1);
-    // Select input channel ADC0 (voltage divider pin)
-    ADMUX &= ~((1<<MUX2) | (1<<MUX1) | (1<<MUX0));
-    // Enable ADC module
-    ADCSRA |= (1<<ADEN);
-    // Enable conversion complete interrupt
-    ADCSRA |= (1<<ADIE);
-    // Set clock prescaler to 128
-    ADCSRA |= ((1<<MUX2) | (1<<MUX1) | (1<<MUX0));
-
-    // Configure 16-bit Timer/Counter1 to start ADC conversion
-    // Set prescaler to 33 ms and enable overflow interrupt
-    TIM1_overflow_33ms();
-    TIM1_overflow_interrupt_enable();
+    // Select ADC voltage reference to "AVcc with external capacitor at AREF pin",
+    // input channel ADC0 and clock prescaler 128. Timer/Counter1 in CTC mode
+    // (ADC_RATE_TIMER in platformio.ini) starts the conversion 30 times per
+    // second by compare match B, no timer interrupt is needed
+    adc_init_rate(&keypad, 1, 30);
 
     // Enables interrupts by setting the global interrupt mask
     sei();
@@ -62,86 +61,50 @@ int main(void)
     // Infinite loop
     while (1)
     {
-        /* Empty loop. All subsequent operations are performed exclusively 
-         * inside interrupt service routines ISRs */
+        // ADC interrupt only stores converted values, LCD is written here
+        if (adc_get(0, &value))
+        {
+            // Convert "value" directly into the frame buffer
+            fmt_dec(lcd_fb_ptr(8, 0), value, 4);
+            fmt_hex(lcd_fb_ptr(13, 0), value, 3);
+
+            key = value >> ADC_OVERSAMPLE;
+            name = "";
+            if(key == 0 || key < 10)
+            {
+              name = "RIGHT";
+            }
+            else if(key > 95 & key < 105)
+            {
+              name = "UP";
+            }
+            else if(key > 250 & key < 260)
+            {
+              name = "DOWN";
+            }
+            else if(key > 405 & key < 415)
+            {
+              name = "LEFT";
+            }
+            else if(key > 635 & key < 645)
+            {
+              name = "SELECT";
+            }
+            else if(key > 1000)
+            {
+              name = "NONE";
+            }
+            lcd_fb_puts(6, 1, "      ");
+            lcd_fb_puts(6, 1, name);
+
+            // Voltage in millivolts, AVcc reference 5 V
+            fmt_dec(lcd_fb_ptr(12, 1), adc_millivolts(value, 5000), 4);
+
+            // Only characters which differ from the display are sent
+            lcd_fb_flush();
+        }
     }
 
     // Will never reach this
     return 0;
 }
-
-
-/* Interrupt service routines ----------------------------------------*/
-/**********************************************************************
- * Function: Timer/Counter1 overflow interrupt
- * Purpose:  Use single conversion mode and start conversion every 100 ms.
- **********************************************************************/
-ISR(TIMER1_OVF_vect)
-{
-    // Start ADC conversion
-    ADCSRA |= (1<<ADSC);
-}
-
-/**********************************************************************
- * Function: ADC complete interrupt
- * Purpose:  Display converted value on LCD screen.
- **********************************************************************/
-ISR(ADC_vect)
-{
-    uint16_t value;
-    uint16_t voltage;
-    char string[4];  // String for converted numbers by itoa()
-
-    // Read converted value
-    // Note that, register pair ADCH and ADCL can be read as a 16-bit value ADC
-    value = ADC;
-    // Convert "value" to "string" and display it
-    itoa(value, string, 10);
-    lcd_gotoxy(8, 0);
-    lcd_puts("    ");
-    lcd_gotoxy(8, 0);
-    lcd_puts(string);
-
-    itoa(value, string, 16);
-    lcd_gotoxy(13, 0);
-    lcd_puts("   ");
-    lcd_gotoxy(13, 0);
-    lcd_puts(string);
-
-    lcd_gotoxy(6, 1);
-    lcd_puts("      ");
-    lcd_gotoxy(6, 1);
-    if(value == 0 || value < 10)
-    {
-      lcd_puts("RIGHT");
-    }
-    else if(value > 95 & value < 105)
-    {
-      lcd_puts("UP");
-    }
-    else if(value > 250 & value < 260)
-    {
-      lcd_puts("DOWN");
-    }
-    else if(value > 405 & value < 415)
-    {
-      lcd_puts("LEFT");
-    }
-    else if(value > 635 & value < 645)
-    {
-      lcd_puts("SELECT");
-    }
-    else if(value > 1000)
-    {
-      lcd_puts("NONE");
-    }
-
-    lcd_gotoxy(12, 1);
-    lcd_puts("    ");
-    lcd_gotoxy(12, 1);
-    voltage = value * 5;
-    voltage *= 1000;
-    voltage /= 1023;
-    itoa(voltage, string, 10);
-    lcd_puts(string);
-} 
\ No newline at end of file
@@ -12,7 +12,32 @@
 
 
 /* Includes ----------------------------------------------------------*/
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <twi.h>
+#include <util/delay.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define TWI_QUEUE_MASK (TWI_QUEUE_SIZE - 1)
+#if (TWI_QUEUE_SIZE & TWI_QUEUE_MASK)
+# error TWI queue size is not a power of 2
+#endif
+
+/* Status code returned by twi_step() when TWINT was not set in time */
+#define TWI_STATUS_TIMEOUT 0xf8
+
+
+/* Variables ---------------------------------------------------------*/
+static twi_xfer_t * volatile twi_queue[TWI_QUEUE_SIZE];
+static volatile uint8_t twi_queue_head;  // Index of next free slot
+static volatile uint8_t twi_queue_tail;  // Index of transaction in progress
+static uint8_t twi_index;                // Index of byte in tx/rx buffer
+static volatile uint8_t twi_steps;       // Number of TWI interrupts, see twi_tick()
+static uint8_t twi_finishing;            // Callback called by twi_finish() is running
+static uint8_t twi_read_error;           // Result of the last twi_read_ack/nack()
+static volatile uint8_t twi_stuck;       // Aborted by twi_tick(), waits for twi_recover()
+uint16_t twi_timeout_us = TWI_STRETCH_US;
 
 
 /* Functions ---------------------------------------------------------*/
@@ -28,8 +53,71 @@ void twi_init(void)
     TWI_PORT |= _BV(TWI_SDA_PIN) | _BV(TWI_SCL_PIN);
 
     /* Set SCL frequency */
-    TWSR &= ~(_BV(TWPS1) | _BV(TWPS0));
-    TWBR = TWI_BIT_RATE_REG;
+    twi_set_frequency(F_SCL);
+}
+
+
+/**********************************************************************
+ * Function: twi_wait()
+ * Purpose:  Wait until TWINT flag is set, i.e. the current bus
+ *           operation is finished, but at most twi_timeout_us.
+ * Returns:  0 - Operation finished
+ *           1 - Timeout, bus is recovered by twi_recover()
+ **********************************************************************/
+static uint8_t twi_wait(void)
+{
+    uint16_t timeout = twi_timeout_us;
+
+    while ((TWCR & _BV(TWINT)) == 0)
+    {
+        if (--timeout == 0)
+        {
+            twi_recover();
+            return 1;
+        }
+        _delay_us(1);
+    }
+    return 0;
+}
+
+
+/**********************************************************************
+ * Function: twi_step()
+ * Purpose:  Write TWI control register and wait until the requested
+ *           bus operation is finished.
+ * Input:    control Value of TWCR register
+ * Returns:  TWI status code with masked prescaler bits or
+ *           TWI_STATUS_TIMEOUT
+ **********************************************************************/
+static uint8_t twi_step(uint8_t control)
+{
+    TWCR = control;
+    if (twi_wait())
+        return TWI_STATUS_TIMEOUT;
+
+    return (TWSR & 0xf8);
+}
+
+
+/**********************************************************************
+ * Function: twi_expect()
+ * Purpose:  Perform one bus operation and compare the resulting TWI
+ *           status code with the expected one.
+ * Inputs:   control Value of TWCR register
+ *           status Expected TWI status code
+ *           error Error code returned for any other status code
+ * Returns:  TWI_OK, TWI_ERR_TIMEOUT or error
+ **********************************************************************/
+static uint8_t twi_expect(uint8_t control, uint8_t status, uint8_t error)
+{
+    uint8_t code = twi_step(control);
+
+    if (code == status)
+        return TWI_OK;
+    else if (code == TWI_STATUS_TIMEOUT)
+        return TWI_ERR_TIMEOUT;
+    else
+        return error;
 }
 
 
@@ -38,31 +126,34 @@ void twi_init(void)
  * Purpose:  Start communication on I2C/TWI bus and send address byte.
  * Inputs:   address Slave address
  *           mode TWI_READ or TWI_WRITE
- * Returns:  0 - Slave device accessible
- *           1 - Failed to access Slave device
+ * Returns:  TWI_OK - Slave device accessible
+ *           TWI_ERR_START, TWI_ERR_ADDR or TWI_ERR_TIMEOUT - Failed to
+ *           access Slave device
  **********************************************************************/
 uint8_t twi_start(uint8_t address, uint8_t mode)
 {
     uint8_t twi_response;
 
-    /* Generate start condition on I2C/TWI bus */
-    TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN);
-    while ((TWCR & _BV(TWINT)) == 0);
+    /* Generate start condition on I2C/TWI bus, status code 0x08 or
+       0x10 (repeated START) is expected */
+    twi_response = twi_step(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN));
+    if (twi_response == TWI_STATUS_TIMEOUT)
+        return TWI_ERR_TIMEOUT;
+    if (twi_response != 0x08 && twi_response != 0x10)
+        return TWI_ERR_START;
 
     /* Send SLA+R or SLA+W frame on I2C/TWI bus */
     TWDR = (address<<1) + mode;
-    TWCR = _BV(TWINT) | _BV(TWEN);
-    while ((TWCR & _BV(TWINT)) == 0);
-
-    /* Check TWI Status Register and mask TWI prescaler bits */
-    twi_response = TWSR & 0xf8;
+    twi_response = twi_step(_BV(TWINT) | _BV(TWEN));
 
     /* Status Code 0x18: SLA+W has been transmitted and ACK received
                    0x40: SLA+R has been transmitted and ACK received */
     if (twi_response == 0x18 || twi_response == 0x40)
-        return 0;   /* Slave device accessible */
+        return TWI_OK;          /* Slave device accessible */
+    else if (twi_response == TWI_STATUS_TIMEOUT)
+        return TWI_ERR_TIMEOUT;
     else
-        return 1;   /* Failed to access Slave device */
+        return TWI_ERR_ADDR;    /* Failed to access Slave device */
 }
 
 
@@ -70,14 +161,14 @@ uint8_t twi_start(uint8_t address, uint8_t mode)
  * Function: twi_write()
  * Purpose:  Send one data byte to I2C/TWI Slave device.
  * Input:    data Byte to be transmitted
- * Returns:  none
+ * Returns:  TWI_OK - Byte acknowledged by Slave device
+ *           TWI_ERR_DATA or TWI_ERR_TIMEOUT - Byte not acknowledged
  **********************************************************************/
-void twi_write(uint8_t data)
+uint8_t twi_write(uint8_t data)
 {
     TWDR = data;
-    TWCR = _BV(TWINT) | _BV(TWEN);
 
-    while ((TWCR & _BV(TWINT)) == 0);
+    return twi_expect(_BV(TWINT) | _BV(TWEN), 0x28, TWI_ERR_DATA);
 }
 
 
@@ -85,13 +176,12 @@ void twi_write(uint8_t data)
  * Function: twi_read_ack()
  * Purpose:  Read one byte from the I2C/TWI Slave device and acknowledge
  *           it with ACK, i.e. communication will continue.
- * Returns:  Received data byte
+ * Returns:  Received data byte, result is stored for twi_error()
  **********************************************************************/
 uint8_t twi_read_ack(void)
 {
-    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
-
-    while ((TWCR & _BV(TWINT)) == 0);
+    /* Status code 0x50: Data byte has been received and ACK returned */
+    twi_read_error = twi_expect(_BV(TWINT) | _BV(TWEN) | _BV(TWEA), 0x50, TWI_ERR_READ);
     return (TWDR);
 }
 
@@ -100,17 +190,27 @@ uint8_t twi_read_ack(void)
  * Function: twi_read_nack()
  * Purpose:  Read one byte from the I2C/TWI Slave device and acknowledge
  *           it with NACK, i.e. communication will not continue.
- * Returns:  Received data byte
+ * Returns:  Received data byte, result is stored for twi_error()
  **********************************************************************/
 uint8_t twi_read_nack(void)
 {
-    TWCR = _BV(TWINT) | _BV(TWEN);
-
-    while ((TWCR & _BV(TWINT)) == 0);
+    /* Status code 0x58: Data byte has been received and NACK returned */
+    twi_read_error = twi_expect(_BV(TWINT) | _BV(TWEN), 0x58, TWI_ERR_READ);
     return (TWDR);
 }
 
 
+/**********************************************************************
+ * Function: twi_error()
+ * Purpose:  Get result of the last twi_read_ack() or twi_read_nack().
+ * Returns:  TWI_OK, TWI_ERR_READ or TWI_ERR_TIMEOUT
+ **********************************************************************/
+uint8_t twi_error(void)
+{
+    return twi_read_error;
+}
+
+
 /**********************************************************************
  * Function: twi_stop()
  * Purpose:  Generates stop condition on I2C/TWI bus.
@@ -119,4 +219,390 @@ uint8_t twi_read_nack(void)
 void twi_stop(void)
 {
     TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
+}
+
+
+/**********************************************************************
+ * Function: twi_recover()
+ * Purpose:  Release I2C/TWI bus blocked by a Slave device holding SDA
+ *           low, clock out up to 9 SCL pulses and generate STOP. Queued
+ *           transactions stopped by twi_tick() are started again.
+ * Returns:  0 - Bus is free
+ *           1 - SDA is still held low
+ **********************************************************************/
+uint8_t twi_recover(void)
+{
+    uint8_t i;
+    uint8_t held;
+
+    /* Disconnect TWI unit and release both lines to pull-ups */
+    TWCR = 0;
+    DDR(TWI_PORT) &= ~(_BV(TWI_SDA_PIN) | _BV(TWI_SCL_PIN));
+    TWI_PORT |= _BV(TWI_SDA_PIN) | _BV(TWI_SCL_PIN);
+    _delay_us(TWI_RECOVER_DELAY_US);
+
+    /* Clock out the byte the Slave device is trying to send */
+    for (i = 0; (i < 9) && !(PIN(TWI_PORT) & _BV(TWI_SDA_PIN)); i++)
+    {
+        TWI_PORT &= ~_BV(TWI_SCL_PIN);
+        DDR(TWI_PORT) |= _BV(TWI_SCL_PIN);     // SCL low
+        _delay_us(TWI_RECOVER_DELAY_US);
+        DDR(TWI_PORT) &= ~_BV(TWI_SCL_PIN);
+        TWI_PORT |= _BV(TWI_SCL_PIN);          // SCL released
+        _delay_us(TWI_RECOVER_DELAY_US);
+    }
+
+    /* STOP condition: SDA rising edge while SCL is high */
+    TWI_PORT &= ~_BV(TWI_SDA_PIN);
+    DDR(TWI_PORT) |= _BV(TWI_SDA_PIN);         // SDA low
+    _delay_us(TWI_RECOVER_DELAY_US);
+    DDR(TWI_PORT) &= ~_BV(TWI_SDA_PIN);
+    TWI_PORT |= _BV(TWI_SDA_PIN);              // SDA released
+    _delay_us(TWI_RECOVER_DELAY_US);
+
+    held = !(PIN(TWI_PORT) & _BV(TWI_SDA_PIN));
+
+    /* Connect TWI unit again */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TWCR = _BV(TWEN);
+        if (twi_stuck)
+        {
+            twi_stuck = 0;
+            if (twi_busy())
+            {
+                twi_index = 0;
+                TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+            }
+        }
+    }
+    return held;
+}
+
+
+/**********************************************************************
+ * Function: twi_read_regs()
+ * Purpose:  Read block of registers from I2C/TWI Slave device in one
+ *           transaction.
+ * Inputs:   address Slave address
+ *           reg Address of the first register
+ *           buf Buffer for received bytes
+ *           len Number of bytes to be read
+ * Returns:  TWI_OK - All bytes received
+ *           TWI_ERR_xxx - Step of the transaction which failed
+ **********************************************************************/
+uint8_t twi_read_regs(uint8_t address, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+    uint8_t err;
+
+    /* START, SLA+W, and register address */
+    if ((err = twi_expect(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN), 0x08, TWI_ERR_START)))
+        goto error;
+    TWDR = (address<<1) + TWI_WRITE;
+    if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x18, TWI_ERR_ADDR)))
+        goto error;
+    TWDR = reg;
+    if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x28, TWI_ERR_DATA)))
+        goto error;
+
+    if (len)
+    {
+        /* Repeated START and SLA+R */
+        if ((err = twi_expect(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN), 0x10, TWI_ERR_START)))
+            goto error;
+        TWDR = (address<<1) + TWI_READ;
+        if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x40, TWI_ERR_ADDR)))
+            goto error;
+
+        /* Acknowledge all bytes except the last one */
+        while (--len)
+        {
+            if ((err = twi_expect(_BV(TWINT) | _BV(TWEN) | _BV(TWEA), 0x50, TWI_ERR_READ)))
+                goto error;
+            *buf++ = TWDR;
+        }
+        if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x58, TWI_ERR_READ)))
+            goto error;
+        *buf = TWDR;
+    }
+
+    twi_stop();
+    return TWI_OK;
+
+error:
+    /* Bus is already released by twi_recover() after timeout */
+    if (err != TWI_ERR_TIMEOUT)
+        twi_stop();
+    return err;
+}
+
+
+/**********************************************************************
+ * Function: twi_write_regs()
+ * Purpose:  Write block of registers to I2C/TWI Slave device in one
+ *           transaction.
+ * Inputs:   address Slave address
+ *           reg Address of the first register
+ *           buf Bytes to be written
+ *           len Number of bytes to be written
+ * Returns:  TWI_OK - All bytes acknowledged by Slave device
+ *           TWI_ERR_xxx - Step of the transaction which failed
+ **********************************************************************/
+uint8_t twi_write_regs(uint8_t address, uint8_t reg, const uint8_t *buf, uint8_t len)
+{
+    uint8_t err;
+
+    /* START, SLA+W, and register address */
+    if ((err = twi_expect(_BV(TWINT) | _BV(TWSTA) | _BV(TWEN), 0x08, TWI_ERR_START)))
+        goto error;
+    TWDR = (address<<1) + TWI_WRITE;
+    if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x18, TWI_ERR_ADDR)))
+        goto error;
+    TWDR = reg;
+    if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x28, TWI_ERR_DATA)))
+        goto error;
+
+    while (len--)
+    {
+        TWDR = *buf++;
+        if ((err = twi_expect(_BV(TWINT) | _BV(TWEN), 0x28, TWI_ERR_DATA)))
+            goto error;
+    }
+
+    twi_stop();
+    return TWI_OK;
+
+error:
+    /* Bus is already released by twi_recover() after timeout */
+    if (err != TWI_ERR_TIMEOUT)
+        twi_stop();
+    return err;
+}
+
+
+/**********************************************************************
+ * Function: twi_scan()
+ * Purpose:  Test all Slave addresses from TWI_SCAN_FIRST to TWI_SCAN_LAST
+ *           back-to-back and mark the responding ones.
+ * Input:    map 16-byte bitmap of detected Slave devices
+ * Returns:  Number of detected Slave devices
+ **********************************************************************/
+uint8_t twi_scan(uint8_t *map)
+{
+    uint8_t sla;
+    uint8_t found = 0;
+    uint16_t timeout;
+
+    for (sla = 0; sla < 16; sla++)
+        map[sla] = 0;
+
+    for (sla = TWI_SCAN_FIRST; sla <= TWI_SCAN_LAST; sla++)
+    {
+        if (twi_start(sla, TWI_WRITE) == TWI_OK)
+        {
+            map[sla >> 3] |= _BV(sla & 7);
+            found++;
+        }
+
+        /* Release the bus and wait for STOP before the next START */
+        twi_stop();
+        for (timeout = twi_timeout_us; (TWCR & _BV(TWSTO)) && timeout; timeout--)
+            _delay_us(1);
+        if (timeout == 0)
+            twi_recover();
+    }
+    return found;
+}
+
+
+/**********************************************************************
+ * Function: twi_submit()
+ * Purpose:  Put transaction to the queue and process it in background
+ *           by TWI interrupt.
+ * Input:    xfer Pointer to transaction descriptor
+ * Returns:  0 - Transaction queued
+ *           1 - Queue is full, transaction not accepted
+ **********************************************************************/
+uint8_t twi_submit(twi_xfer_t *xfer)
+{
+    uint8_t tmphead;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tmphead = (twi_queue_head + 1) & TWI_QUEUE_MASK;
+        if (tmphead == twi_queue_tail)
+            return 1;   /* Queue is full */
+
+        xfer->status = TWI_XFER_BUSY;
+        twi_queue[twi_queue_head] = xfer;
+
+        /* Start the bus only if no other transaction is in progress.
+           Callback of the finished one leaves it to twi_finish(), which
+           generates STOP followed by START. STOP of the previous
+           transaction may still be in progress, TWSTO is kept set so
+           that TWI generates START right after it */
+        if ((twi_queue_head == twi_queue_tail) && !twi_finishing && !twi_stuck)
+        {
+            twi_index = 0;
+            TWCR = (TWCR & _BV(TWSTO)) | _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+        }
+        twi_queue_head = tmphead;
+    }
+    return 0;
+}
+
+
+/**********************************************************************
+ * Function: twi_busy()
+ * Purpose:  Test whether background transactions are in progress.
+ * Returns:  0 - Queue is empty and I2C/TWI unit is idle
+ *           1 - At least one transaction is queued or in progress
+ **********************************************************************/
+uint8_t twi_busy(void)
+{
+    return (twi_queue_head != twi_queue_tail);
+}
+
+
+/**********************************************************************
+ * Function: twi_finish()
+ * Purpose:  Store result of the current transaction, call its callback,
+ *           and generate STOP or STOP followed by START of the next
+ *           queued transaction.
+ * Input:    xfer Transaction in progress
+ *           status TWI_XFER_OK or status code of failed step
+ * Returns:  none
+ **********************************************************************/
+static void twi_finish(twi_xfer_t *xfer, uint8_t status)
+{
+    xfer->status = status;
+    twi_queue_tail = (twi_queue_tail + 1) & TWI_QUEUE_MASK;
+    if (xfer->callback)
+    {
+        /* Transaction submitted by the callback does not touch TWCR */
+        twi_finishing = 1;
+        xfer->callback(xfer);
+        twi_finishing = 0;
+    }
+
+    /* Bus aborted by twi_tick() is left to twi_recover() */
+    if (twi_stuck)
+        return;
+
+    twi_index = 0;
+    if (twi_queue_head != twi_queue_tail)
+        TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+    else
+        TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
+}
+
+
+/**********************************************************************
+ * Function: twi_stalled()
+ * Purpose:  Test whether twi_tick() aborted a transaction and the bus
+ *           waits for twi_recover().
+ * Returns:  0 - Bus is not blocked
+ *           1 - twi_recover() must be called
+ **********************************************************************/
+uint8_t twi_stalled(void)
+{
+    return twi_stuck;
+}
+
+
+/**********************************************************************
+ * Function: twi_tick()
+ * Purpose:  Abort background transaction which made no progress since
+ *           the previous call and disconnect TWI unit. Clocking the
+ *           bus free takes about 100 us, so twi_recover() is left to
+ *           the main loop.
+ * Returns:  none
+ **********************************************************************/
+void twi_tick(void)
+{
+    static uint8_t last_steps;
+    static uint8_t was_busy = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (was_busy && twi_busy() && (twi_steps == last_steps))
+        {
+            TWCR = 0;
+            twi_stuck = 1;
+            twi_finish(twi_queue[twi_queue_tail], TWI_XFER_TIMEOUT);
+        }
+        /* Queued transactions do not run until twi_recover() */
+        was_busy = twi_busy() && !twi_stuck;
+        last_steps = twi_steps;
+    }
+}
+
+
+/**********************************************************************
+ * Function: TWI interrupt
+ * Purpose:  Advance the transaction in progress by one bus step
+ *           according to TWI status code.
+ **********************************************************************/
+ISR(TWI_vect)
+{
+    twi_xfer_t *xfer = twi_queue[twi_queue_tail];
+    uint8_t status = TWSR & 0xf8;
+
+    twi_steps++;
+
+    switch (status)
+    {
+    case 0x08:  /* START has been transmitted */
+    case 0x10:  /* Repeated START has been transmitted */
+        /* Read phase follows once all bytes have been written */
+        if ((twi_index >= xfer->tx_len) && xfer->rx_len)
+            TWDR = (xfer->address<<1) + TWI_READ;
+        else
+            TWDR = (xfer->address<<1) + TWI_WRITE;
+        TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        break;
+
+    case 0x18:  /* SLA+W has been transmitted and ACK received */
+    case 0x28:  /* Data byte has been transmitted and ACK received */
+        if (twi_index < xfer->tx_len)
+        {
+            TWDR = xfer->tx_buf[twi_index++];
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        }
+        else if (xfer->rx_len)
+            TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+        else
+            twi_finish(xfer, TWI_XFER_OK);
+        break;
+
+    case 0x40:  /* SLA+R has been transmitted and ACK received */
+        twi_index = 0;
+        /* ACK all bytes except the last one */
+        if (xfer->rx_len > 1)
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+        else
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        break;
+
+    case 0x50:  /* Data byte has been received and ACK returned */
+        xfer->rx_buf[twi_index++] = TWDR;
+        if (twi_index < (xfer->rx_len - 1))
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+        else
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        break;
+
+    case 0x58:  /* Data byte has been received and NACK returned */
+        xfer->rx_buf[twi_index] = TWDR;
+        twi_finish(xfer, TWI_XFER_OK);
+        break;
+
+    case 0x00:  /* Illegal START or STOP condition */
+        twi_finish(xfer, TWI_XFER_BUS_ERROR);
+        break;
+
+    default:    /* NACK received (0x20, 0x30, 0x48) or arbitration lost (0x38) */
+        twi_finish(xfer, status);
+        break;
+    }
 }
\ No newline at end of file
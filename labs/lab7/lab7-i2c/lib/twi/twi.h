@@ -48,10 +48,13 @@
  * @name Definition of frequencies 
  */
 #ifndef F_CPU
-# define F_CPU 16000000 /**< @brief CPU frequency in Hz required TWI_BIT_RATE_REG */
+# define F_CPU 16000000 /**< @brief CPU frequency in Hz required by twi_set_frequency() */
 #endif
-#define F_SCL 50000 /**< @brief I2C/TWI bit rate. Must be greater than 31000 */
-#define TWI_BIT_RATE_REG ((F_CPU/F_SCL - 16) / 2) /**< @brief TWI bit rate register value */
+#ifndef F_SCL
+# define F_SCL 50000 /**< @brief Default I2C/TWI bit rate set by twi_init() */
+#endif
+#define TWI_FREQ_STANDARD 100000 /**< @brief I2C/TWI Standard mode bit rate */
+#define TWI_FREQ_FAST     400000 /**< @brief I2C/TWI Fast mode bit rate */
 
 
 /**
@@ -73,14 +76,141 @@
 #define PIN(_x) (*(&_x - 2))
 
 
+/**
+ * @name Definitions for bus scanner
+ */
+#define TWI_SCAN_FIRST 8   /**< @brief First address tested by twi_scan() */
+#define TWI_SCAN_LAST  119 /**< @brief Last address tested by twi_scan() */
+/** @brief Test whether Slave _adr was detected in bitmap _map filled by twi_scan() */
+#define TWI_SCAN_PRESENT(_map, _adr) ((_map)[(_adr) >> 3] & _BV((_adr) & 7))
+
+
+/**
+ * @name Definitions for interrupt-driven transactions
+ */
+#ifndef TWI_QUEUE_SIZE
+# define TWI_QUEUE_SIZE 4 /**< @brief Number of queued transactions, must be power of 2 */
+#endif
+#define TWI_XFER_OK        0x00 /**< @brief Transaction finished successfully */
+#define TWI_XFER_BUS_ERROR 0x01 /**< @brief Illegal START or STOP detected on the bus */
+#define TWI_XFER_TIMEOUT   0x02 /**< @brief Transaction aborted by twi_tick() */
+#define TWI_XFER_BUSY      0xff /**< @brief Transaction is queued or in progress */
+
+
+/**
+ * @name Definitions of timeouts and error codes
+ */
+#ifndef TWI_STRETCH_US
+# define TWI_STRETCH_US 1000 /**< @brief Clock stretching by Slave allowed in one bus operation, in microseconds */
+#endif
+#define TWI_RECOVER_DELAY_US 5 /**< @brief Half period of SCL pulses generated by twi_recover() */
+#define TWI_OK          0 /**< @brief Operation finished successfully */
+#define TWI_ERR_START   1 /**< @brief START condition not transmitted */
+#define TWI_ERR_ADDR    2 /**< @brief SLA+W or SLA+R not acknowledged by Slave */
+#define TWI_ERR_DATA    3 /**< @brief Transmitted data byte not acknowledged by Slave */
+#define TWI_ERR_READ    4 /**< @brief Data byte not received */
+#define TWI_ERR_TIMEOUT 5 /**< @brief Bus operation not finished in twi_timeout_us, bus recovered */
+
+
+/* Type definitions --------------------------------------------------*/
+/**
+ * @brief  Descriptor of one interrupt-driven I2C/TWI transaction.
+ *
+ * Transaction consists of an optional write phase (START, SLA+W and
+ * tx_len data bytes) followed by an optional read phase (repeated
+ * START, SLA+R and rx_len data bytes) and is finished by STOP. The
+ * descriptor and both buffers must remain valid until the transaction
+ * is finished.
+ */
+typedef struct twi_xfer {
+    uint8_t address;        /**< @brief 7-bit Slave address */
+    const uint8_t *tx_buf;  /**< @brief Bytes to be written to Slave */
+    uint8_t tx_len;         /**< @brief Number of bytes to be written */
+    uint8_t *rx_buf;        /**< @brief Buffer for bytes read from Slave */
+    uint8_t rx_len;         /**< @brief Number of bytes to be read */
+    /** @brief Optional function called from TWI interrupt when finished */
+    void (*callback)(struct twi_xfer *xfer);
+    /** @brief TWI_XFER_BUSY, TWI_XFER_OK or TWI status code of failure */
+    volatile uint8_t status;
+} twi_xfer_t;
+
+
+/* Variables ---------------------------------------------------------*/
+/** @brief Maximum time of one bus operation in microseconds, i.e. 9 SCL
+ *         periods plus TWI_STRETCH_US, set by twi_set_frequency() */
+extern uint16_t twi_timeout_us;
+
+
 /* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Set SCL frequency of I2C/TWI bus.
+ * @param  hz Required SCL frequency in Hz, such as TWI_FREQ_FAST
+ * @return none
+ * @par    Implementation notes:
+ *           - Bit rate register TWBR and prescaler TWPS are calculated
+ *             as follows fscl = fcpu/(16 + 2*TWBR*4^TWPS), the lowest
+ *             prescaler is used and the resulting frequency never
+ *             exceeds the required one
+ *           - Function is inlined, so the calculation is folded by the
+ *             compiler when the argument is a constant
+ *           - Frequencies lower than fcpu/(16 + 2*255*64) are limited
+ *             to this value
+ *           - Timeout of blocking functions twi_timeout_us is set to
+ *             9 periods of the resulting SCL plus TWI_STRETCH_US
+ */
+static inline __attribute__((always_inline)) void twi_set_frequency(uint32_t hz)
+{
+    uint32_t div;   // Required value of TWBR * 4^TWPS
+    uint8_t ps;     // TWI prescaler bits
+    uint32_t us;    // Timeout of one bus operation
+
+    /* Round up, so SCL is never faster than required, e.g. at 16 MHz
+       100 kHz: TWBR = 72, fscl = 100 kHz
+       400 kHz: TWBR = 12, fscl = 400 kHz
+       395 kHz: TWBR = 13, fscl = 381 kHz (not 12 and 400 kHz) */
+    if ((uint32_t) F_CPU <= 16 * hz)
+        div = 0;
+    else
+        div = ((uint32_t) F_CPU - 16 * hz + 2 * hz - 1) / (2 * hz);
+
+    if (div <= 255)
+        ps = 0;
+    else if (div <= 255UL * 4)
+    {
+        ps = 1;
+        div = (div + 3) / 4;
+    }
+    else if (div <= 255UL * 16)
+    {
+        ps = 2;
+        div = (div + 15) / 16;
+    }
+    else
+    {
+        ps = 3;
+        div = (div + 63) / 64;
+        if (div > 255)
+            div = 255;
+    }
+
+    TWSR = (TWSR & ~(_BV(TWPS1) | _BV(TWPS0))) | ps;
+    TWBR = (uint8_t) div;
+
+    /* One byte and its acknowledge take 9 SCL periods of
+       16 + 2*TWBR*4^TWPS CPU cycles, Slave may stretch them */
+    us = (9 * (16 + 2 * div * (1UL << (2 * ps))) + F_CPU / 1000000 - 1)
+         / (F_CPU / 1000000) + TWI_STRETCH_US;
+    twi_timeout_us = (us > 0xffff) ? 0xffff : (uint16_t) us;
+}
+
+
 /**
  * @brief  Initialize TWI unit, enable internal pull-ups, and set SCL frequency.
  * @par    Implementation notes:
  *           - AVR internal pull-up resistors at pins TWI_SDA_PIN and
  *             TWI_SCL_PIN are enabled
- *           - TWI bit rate register value is calculated as follows
- *             fscl = fcpu/(16 + 2*TWBR)
+ *           - SCL frequency is set to F_SCL by twi_set_frequency(),
+ *             which can be called later to change the bus speed
  * @return none
  */
 void twi_init(void);
@@ -90,8 +220,10 @@ void twi_init(void);
  * @brief  Start communication on I2C/TWI bus and send address byte.
  * @param  address Slave address
  * @param  mode TWI_READ or TWI_WRITE
- * @retval 0 - Slave device accessible
- * @retval 1 - Failed to access Slave device
+ * @retval TWI_OK - Slave device accessible
+ * @retval TWI_ERR_START - START condition not transmitted
+ * @retval TWI_ERR_ADDR - Slave device did not acknowledge its address
+ * @retval TWI_ERR_TIMEOUT - Bus is blocked, twi_recover() was called
  * @note   Function returns 0 only if 0x18 or 0x40 status code is detected\n
  *           0x18: SLA+W has been transmitted and ACK has been received\n
  *           0x40: SLA+R has been transmitted and ACK has been received\n
@@ -102,15 +234,17 @@ uint8_t twi_start(uint8_t address, uint8_t mode);
 /**
  * @brief  Send one data byte to I2C/TWI Slave device.
  * @param  data Byte to be transmitted
- * @return none
+ * @retval TWI_OK - Byte acknowledged by Slave device
+ * @retval TWI_ERR_DATA - Byte not acknowledged
+ * @retval TWI_ERR_TIMEOUT - Bus is blocked, twi_recover() was called
  */
-void twi_write(uint8_t data);
+uint8_t twi_write(uint8_t data);
 
 
 /**
  * @brief  Read one byte from the I2C/TWI Slave device and acknowledge
  *         it with ACK, i.e. communication will continue.
- * @return Received data byte
+ * @return Received data byte, valid only if twi_error() returns TWI_OK
  */
 uint8_t twi_read_ack(void);
 
@@ -118,11 +252,20 @@ uint8_t twi_read_ack(void);
 /**
  * @brief  Read one byte from the I2C/TWI Slave device and acknowledge
  *         it with NACK, i.e. communication will not continue.
- * @return Received data byte
+ * @return Received data byte, valid only if twi_error() returns TWI_OK
  */
 uint8_t twi_read_nack(void);
 
 
+/**
+ * @brief  Get result of the last twi_read_ack() or twi_read_nack().
+ * @retval TWI_OK - Byte received
+ * @retval TWI_ERR_READ - Unexpected TWI status code
+ * @retval TWI_ERR_TIMEOUT - Bus is blocked, twi_recover() was called
+ */
+uint8_t twi_error(void);
+
+
 /**
  * @brief  Generates stop condition on I2C/TWI bus.
  * @return none
@@ -130,6 +273,133 @@ uint8_t twi_read_nack(void);
 void twi_stop(void);
 
 
+/**
+ * @brief  Release I2C/TWI bus blocked by a Slave device holding SDA low.
+ * @retval 0 - Bus is free
+ * @retval 1 - SDA is still held low
+ * @par    Implementation notes:
+ *           - TWI unit is disconnected and up to 9 SCL pulses are
+ *             generated until the Slave device releases SDA, followed
+ *             by STOP condition
+ *           - Function is called automatically when any blocking bus
+ *             operation does not finish within twi_timeout_us
+ *           - Call it from the main loop when twi_stalled() returns
+ *             non-zero value, background transactions queued after
+ *             the aborted one are started again
+ */
+uint8_t twi_recover(void);
+
+
+/**
+ * @brief  Read block of registers from I2C/TWI Slave device in one
+ *         transaction.
+ * @param  address Slave address
+ * @param  reg Address of the first register
+ * @param  buf Buffer for received bytes
+ * @param  len Number of bytes to be read
+ * @retval TWI_OK - All bytes received
+ * @retval TWI_ERR_xxx - Step of the transaction which failed
+ * @par    Implementation notes:
+ *           - Sequence START, SLA+W, reg, repeated START, SLA+R, len
+ *             bytes (last one acknowledged by NACK), and STOP is
+ *             generated
+ *           - TWI status code is checked after every step and STOP is
+ *             generated on the first failure
+ */
+uint8_t twi_read_regs(uint8_t address, uint8_t reg, uint8_t *buf, uint8_t len);
+
+
+/**
+ * @brief  Write block of registers to I2C/TWI Slave device in one
+ *         transaction.
+ * @param  address Slave address
+ * @param  reg Address of the first register
+ * @param  buf Bytes to be written
+ * @param  len Number of bytes to be written
+ * @retval TWI_OK - All bytes acknowledged by Slave device
+ * @retval TWI_ERR_xxx - Step of the transaction which failed
+ * @par    Implementation notes:
+ *           - Sequence START, SLA+W, reg, len bytes, and STOP is
+ *             generated
+ *           - TWI status code is checked after every step and STOP is
+ *             generated on the first failure
+ */
+uint8_t twi_write_regs(uint8_t address, uint8_t reg, const uint8_t *buf, uint8_t len);
+
+
+/**
+ * @brief  Test all Slave addresses from TWI_SCAN_FIRST to TWI_SCAN_LAST
+ *         back-to-back and mark the responding ones.
+ * @param  map 16-byte (128-bit) bitmap, bit n is set if Slave with
+ *             address n acknowledged its SLA+W frame
+ * @return Number of detected Slave devices
+ * @par    Implementation notes:
+ *           - Every address is tested by START, SLA+W and STOP, and the
+ *             function waits until STOP is really generated before the
+ *             next address, so a NACK-ed address leaves the bus free
+ *           - Use TWI_SCAN_PRESENT() to test the bitmap
+ */
+uint8_t twi_scan(uint8_t *map);
+
+
+/**
+ * @brief  Put transaction to the queue and process it in background
+ *         by TWI interrupt.
+ * @param  xfer Pointer to transaction descriptor
+ * @retval 0 - Transaction queued
+ * @retval 1 - Queue is full, transaction not accepted
+ * @par    Implementation notes:
+ *           - Function can be called from ISR, the caller only enqueues
+ *             work and does not wait for the I2C/TWI bus
+ *           - xfer->status is TWI_XFER_BUSY until the transaction is
+ *             finished, then TWI_XFER_OK or status code of the failed
+ *             step (0x20, 0x30, 0x48, ...) is stored and the callback
+ *             is called from interrupt context
+ *           - Callback may submit the next transaction, which is
+ *             started by STOP followed by START when the callback
+ *             returns
+ *           - Transaction submitted while twi_stalled() returns
+ *             non-zero value waits for twi_recover()
+ *           - Do not use blocking functions twi_start() .. twi_stop()
+ *             while twi_busy() returns non-zero value
+ */
+uint8_t twi_submit(twi_xfer_t *xfer);
+
+
+/**
+ * @brief  Test whether background transactions are in progress.
+ * @retval 0 - Queue is empty and I2C/TWI unit is idle
+ * @retval 1 - At least one transaction is queued or in progress
+ */
+uint8_t twi_busy(void);
+
+
+/**
+ * @brief  Watchdog of background transactions, call it periodically,
+ *         e.g. from timer interrupt.
+ * @return none
+ * @par    Implementation notes:
+ *           - Transaction which made no progress between two
+ *             consecutive calls is finished with TWI_XFER_TIMEOUT
+ *             status and TWI unit is disconnected
+ *           - Bus recovery takes about 100 us of SCL pulses, so it is
+ *             not performed here; call twi_recover() from the main
+ *             loop once twi_stalled() returns non-zero value
+ *           - The period must be longer than the longest expected
+ *             transaction
+ */
+void twi_tick(void);
+
+
+/**
+ * @brief  Test whether a background transaction was aborted by
+ *         twi_tick() and the bus waits for twi_recover().
+ * @retval 0 - Bus is not blocked
+ * @retval 1 - twi_recover() must be called from the main loop
+ */
+uint8_t twi_stalled(void);
+
+
 /** @} */
 
 #endif
\ No newline at end of file
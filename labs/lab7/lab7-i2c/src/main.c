@@ -1,7 +1,7 @@
 /***********************************************************************
  * 
- * The I2C (TWI) bus scanner tests all addresses and detects chips and
- * modules that are connected to the SDA and SCL signals.
+ * Read humidity and temperature from DHT12 sensor by interrupt-driven
+ * I2C (TWI) transactions and send the values to UART.
  * 
  * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
  *
@@ -27,38 +27,112 @@
 #include <stdlib.h>         // C library. Needed for number conversions
 
 
+/* Defines -----------------------------------------------------------*/
+#define SENSOR_ADR 0x5c     // I2C address of DHT12 humidity/temperature sensor
+#define SENSOR_HUM_MEM 0    // DHT12 register with the first humidity byte
+
+
+/* Variables ---------------------------------------------------------*/
+struct Air_parameters_structure {
+    uint8_t humid_int;
+    uint8_t humid_dec;
+    uint8_t temp_int;
+    uint8_t temp_dec;
+    uint8_t checksum;
+} air;
+
+static const uint8_t air_reg = SENSOR_HUM_MEM;
+static volatile uint8_t new_sensor_data = 0;
+
+static void air_read_done(twi_xfer_t *xfer);
+
+static twi_xfer_t air_xfer = {
+    .address  = SENSOR_ADR,
+    .tx_buf   = &air_reg,
+    .tx_len   = 1,
+    .rx_buf   = (uint8_t *) &air,
+    .rx_len   = sizeof(air),
+    .callback = air_read_done,
+};
+
+
 /* Function definitions ----------------------------------------------*/
 /**********************************************************************
  * Function: Main function where the program execution begins
- * Purpose:  Use Timer/Counter1, send one I2C (TWI) address every 33 ms,
- *           and test all combinations. Send information about scanning
- *           process to UART.
+ * Purpose:  Scan I2C (TWI) bus for devices at boot, then use
+ *           Timer/Counter1 and read humidity and temperature from
+ *           DHT12 sensor every second. The I2C (TWI) transaction runs
+ *           in background and the received values are sent to UART.
  * Returns:  none
  **********************************************************************/
 int main(void)
 {
+    char string[4];  // String for converting numbers by itoa()
+    uint8_t devices[16];  // Bitmap of detected I2C devices
+    uint8_t sla;
+
     // Initialize I2C (TWI)
     twi_init();
 
     // Initialize USART to asynchronous, 8N1, 9600
     uart_init(UART_BAUD_SELECT(9600, F_CPU));
 
-    // Configure 16-bit Timer/Counter1 to test one I2C address
-    // Set prescaler to 33 ms and enable interrupt
-    TIM1_overflow_33ms();
-    TIM1_overflow_interrupt_enable();
-
     // Enables interrupts by setting the global interrupt mask
     sei();
 
-    // Put strings to ringbuffer for transmitting via UART
+    // Scan the whole I2C address range once at boot
     uart_puts("Scan I2C bus for devices:\r\n");
+    twi_scan(devices);
+    for (sla = TWI_SCAN_FIRST; sla <= TWI_SCAN_LAST; sla++)
+    {
+        if (TWI_SCAN_PRESENT(devices, sla))
+        {
+            itoa(sla, string, 16);
+            uart_puts("  0x");
+            uart_puts(string);
+            uart_puts("\r\n");
+        }
+    }
+
+    // Configure 16-bit Timer/Counter1 to read sensor data
+    // Set prescaler to 1 sec and enable interrupt
+    TIM1_overflow_1s();
+    TIM1_overflow_interrupt_enable();
+
+    // Put strings to ringbuffer for transmitting via UART
+    uart_puts("Read DHT12 sensor:\r\n");
 
     // Infinite loop
     while (1)
     {
-        /* Empty loop. All subsequent operations are performed exclusively 
-         * inside interrupt service routines ISRs */
+        // Bus got stuck, release it outside of interrupts
+        if (twi_stalled())
+            twi_recover();
+
+        if (new_sensor_data)
+        {
+            new_sensor_data = 0;
+
+            if (air_xfer.status == TWI_XFER_OK)
+            {
+                itoa(air.temp_int, string, 10);
+                uart_puts(string);
+                uart_puts(".");
+                itoa(air.temp_dec, string, 10);
+                uart_puts(string);
+                uart_puts(" C\t");
+                itoa(air.humid_int, string, 10);
+                uart_puts(string);
+                uart_puts(".");
+                itoa(air.humid_dec, string, 10);
+                uart_puts(string);
+                uart_puts(" %\r\n");
+            }
+            else
+            {
+                uart_puts("Sensor not responding\r\n");
+            }
+        }
     }
 
     // Will never reach this
@@ -66,41 +140,32 @@ int main(void)
 }
 
 
+/**********************************************************************
+ * Function: air_read_done()
+ * Purpose:  Completion callback of the sensor transaction, called from
+ *           TWI interrupt.
+ * Input:    xfer Finished transaction
+ * Returns:  none
+ **********************************************************************/
+static void air_read_done(twi_xfer_t *xfer)
+{
+    new_sensor_data = 1;
+}
+
+
 /* Interrupt service routines ----------------------------------------*/
 /**********************************************************************
  * Function: Timer/Counter1 overflow interrupt
- * Purpose:  Test one I2C Slave address from the range 8 to 119.
+ * Purpose:  Enqueue one read of humidity, temperature and checksum
+ *           from DHT12 sensor. The bus transaction itself is performed
+ *           by TWI interrupt, stalled one is aborted by twi_tick().
  **********************************************************************/
 ISR(TIMER1_OVF_vect)
 {
-    static uint8_t sla = 8;  // I2C Slave address
-    uint8_t ack;             // ACK response from Slave
-    char string[3];          // String for converting numbers by itoa()
-    struct Air_parameters_structure {
-    uint8_t humid_int;
-    uint8_t humid_dec;
-    uint8_t temp_int;
-    uint8_t temp_dec;
-    uint8_t checksum;
-} air;
+    // Abort the previous read if the bus got stuck
+    twi_tick();
 
-    // Start communication, transmit I2C Slave address, get result,
-    // and Stop communication
-    ack = twi_start(sla, TWI_WRITE);
-    twi_write(adr);
-    twi_stop();
-    
-    ack = twi_start(sla, TWI_READ);
-    air.humid_int = twi_read_ack();
-    twi_stop();
-
-    if(no_overflow > 29) {
-    itoa(air.temp_int, string, 10);
-    uart_puts(string);
-    uart_puts(".")
-    }
-    
-
-    // Test ACK/NACK value obtained from I2C bus and send info to UART
-    
-}
\ No newline at end of file
+    // Do not resubmit the descriptor while the previous read is pending
+    if (air_xfer.status != TWI_XFER_BUSY)
+        twi_submit(&air_xfer);
+}
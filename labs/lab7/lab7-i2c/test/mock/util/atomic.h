@@ -0,0 +1,66 @@
+#ifndef MOCK_UTIL_ATOMIC_H
+# define MOCK_UTIL_ATOMIC_H
+
+/***********************************************************************
+ *
+ * Host replacement of <util/atomic.h> for unit tests of the libraries.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @brief Same construction as avr-libc, on the mocked SREG.
+ *
+ * The I flag is cleared for the block and restored by a cleanup
+ * function, also when the block is left by return.
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/interrupt.h>
+
+
+/* Function definitions ----------------------------------------------*/
+static inline uint8_t mock_cli_ret(void)
+{
+    cli();
+    return 1;
+}
+
+static inline void mock_restore(const uint8_t *sreg)
+{
+    SREG = *sreg;
+}
+
+static inline void mock_force_on(const uint8_t *sreg)
+{
+    (void) sreg;
+    sei();
+}
+
+static inline void mock_force_off(const uint8_t *sreg)
+{
+    (void) sreg;
+    cli();
+}
+
+
+/* Defines -----------------------------------------------------------*/
+#define ATOMIC_BLOCK(type) \
+    for (type, mock_todo = mock_cli_ret(); mock_todo; mock_todo = 0)
+#define NONATOMIC_BLOCK(type) \
+    for (type, mock_todo = (sei(), 1); mock_todo; mock_todo = 0)
+
+#define ATOMIC_RESTORESTATE \
+    uint8_t mock_sreg __attribute__((__cleanup__(mock_restore))) = SREG
+#define ATOMIC_FORCEON \
+    uint8_t mock_sreg __attribute__((__cleanup__(mock_force_on))) = 0
+#define NONATOMIC_RESTORESTATE ATOMIC_RESTORESTATE
+#define NONATOMIC_FORCEOFF \
+    uint8_t mock_sreg __attribute__((__cleanup__(mock_force_off))) = 0
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MOCK_UTIL_DELAY_H
+# define MOCK_UTIL_DELAY_H
+
+/***********************************************************************
+ *
+ * Host replacement of <util/delay.h> for unit tests of the libraries.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @brief Busy-wait delays return immediately, timeouts of the
+ *        libraries expire after their number of loop iterations.
+ */
+
+
+/* Function definitions ----------------------------------------------*/
+static inline void _delay_us(double us)
+{
+    (void) us;
+}
+
+static inline void _delay_ms(double ms)
+{
+    (void) ms;
+}
+
+#endif
@@ -0,0 +1,180 @@
+/***********************************************************************
+ *
+ * Unit tests of the lock-free ring buffer, run by "pio test -e native".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <ring.h>
+
+
+/* Types -------------------------------------------------------------*/
+typedef struct
+{
+    uint8_t data;
+    uint8_t rs;
+} entry_t;
+
+// Ring buffers byte_ring_t, max_ring_t and entry_ring_t
+RING_DEFINE(byte_ring, uint8_t, 8)
+RING_DEFINE(max_ring, uint8_t, 256)
+RING_DEFINE(entry_ring, entry_t, 4)
+
+
+/* Variables ---------------------------------------------------------*/
+static byte_ring_t ring;
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    byte_ring_init(&ring);
+}
+
+
+void tearDown(void)
+{
+}
+
+
+void test_empty_after_init(void)
+{
+    uint8_t value;
+
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_count(&ring));
+    TEST_ASSERT_EQUAL_UINT8(7, byte_ring_space(&ring));
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_pop(&ring, &value));
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_drop(&ring));
+}
+
+
+void test_pop_in_push_order(void)
+{
+    uint8_t value;
+
+    TEST_ASSERT_EQUAL_UINT8(1, byte_ring_push(&ring, 10));
+    TEST_ASSERT_EQUAL_UINT8(1, byte_ring_push(&ring, 20));
+    TEST_ASSERT_EQUAL_UINT8(2, byte_ring_count(&ring));
+
+    TEST_ASSERT_EQUAL_UINT8(1, byte_ring_pop(&ring, &value));
+    TEST_ASSERT_EQUAL_UINT8(10, value);
+    TEST_ASSERT_EQUAL_UINT8(1, byte_ring_pop(&ring, &value));
+    TEST_ASSERT_EQUAL_UINT8(20, value);
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_pop(&ring, &value));
+}
+
+
+void test_full_keeps_one_slot_unused(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < 7; i++)
+        TEST_ASSERT_EQUAL_UINT8(1, byte_ring_push(&ring, i));
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_push(&ring, 7));
+    TEST_ASSERT_EQUAL_UINT8(7, byte_ring_count(&ring));
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_space(&ring));
+}
+
+
+void test_indexes_wrap_around(void)
+{
+    uint8_t value;
+    uint16_t i;
+
+    // Head and tail pass the end of the buffer many times
+    for (i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(1, byte_ring_push(&ring, i));
+        TEST_ASSERT_EQUAL_UINT8(1, byte_ring_push(&ring, i + 1));
+        TEST_ASSERT_EQUAL_UINT8(1, byte_ring_pop(&ring, &value));
+        TEST_ASSERT_EQUAL_UINT8(i, value);
+        TEST_ASSERT_EQUAL_UINT8(1, byte_ring_pop(&ring, &value));
+        TEST_ASSERT_EQUAL_UINT8(i + 1, value);
+        TEST_ASSERT_EQUAL_UINT8(0, byte_ring_count(&ring));
+    }
+}
+
+
+void test_drop_discards_oldest(void)
+{
+    uint8_t value;
+
+    byte_ring_push(&ring, 1);
+    byte_ring_push(&ring, 2);
+    TEST_ASSERT_EQUAL_UINT8(1, byte_ring_drop(&ring));
+    TEST_ASSERT_EQUAL_UINT8(1, byte_ring_pop(&ring, &value));
+    TEST_ASSERT_EQUAL_UINT8(2, value);
+}
+
+
+void test_write_stores_only_what_fits(void)
+{
+    const uint8_t src[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    uint8_t dst[10] = {0};
+
+    byte_ring_push(&ring, 0xff);
+    byte_ring_drop(&ring);          // Block starts in the middle
+
+    TEST_ASSERT_EQUAL_UINT8(7, byte_ring_write(&ring, src, 10));
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_write(&ring, src, 1));
+    TEST_ASSERT_EQUAL_UINT8(3, byte_ring_read(&ring, dst, 3));
+    TEST_ASSERT_EQUAL_UINT8(4, byte_ring_read(&ring, dst + 3, 10));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(src, dst, 7);
+    TEST_ASSERT_EQUAL_UINT8(0, byte_ring_count(&ring));
+}
+
+
+void test_size_256_uses_whole_index_range(void)
+{
+    static max_ring_t big;
+    uint8_t value;
+    uint16_t i;
+
+    max_ring_init(&big);
+    for (i = 0; i < 255; i++)
+        TEST_ASSERT_EQUAL_UINT8(1, max_ring_push(&big, (uint8_t) i));
+    TEST_ASSERT_EQUAL_UINT8(0, max_ring_push(&big, 0));
+    TEST_ASSERT_EQUAL_UINT8(255, max_ring_count(&big));
+
+    for (i = 0; i < 255; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(1, max_ring_pop(&big, &value));
+        TEST_ASSERT_EQUAL_UINT8((uint8_t) i, value);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, max_ring_count(&big));
+}
+
+
+void test_structure_elements(void)
+{
+    entry_ring_t entries;
+    entry_t entry = {0x80, 1};
+    entry_t out;
+
+    entry_ring_init(&entries);
+    TEST_ASSERT_EQUAL_UINT8(1, entry_ring_push(&entries, entry));
+    TEST_ASSERT_EQUAL_UINT8(1, entry_ring_pop(&entries, &out));
+    TEST_ASSERT_EQUAL_UINT8(0x80, out.data);
+    TEST_ASSERT_EQUAL_UINT8(1, out.rs);
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_after_init);
+    RUN_TEST(test_pop_in_push_order);
+    RUN_TEST(test_full_keeps_one_slot_unused);
+    RUN_TEST(test_indexes_wrap_around);
+    RUN_TEST(test_drop_discards_oldest);
+    RUN_TEST(test_write_stores_only_what_fits);
+    RUN_TEST(test_size_256_uses_whole_index_range);
+    RUN_TEST(test_structure_elements);
+    return UNITY_END();
+}
@@ -0,0 +1,293 @@
+/***********************************************************************
+ *
+ * Unit tests of the I2C/TWI library on mocked registers, run by
+ * "pio test -e native".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <twi.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define SLA 0x5c            // Slave address used by the tests
+
+// TWCR values written by the interrupt
+#define TWCR_NEXT  (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+#define TWCR_START (_BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE))
+#define TWCR_STOP  (_BV(TWINT) | _BV(TWSTO) | _BV(TWEN))
+#define TWCR_STOP_START (_BV(TWINT) | _BV(TWSTO) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE))
+
+
+/* Variables ---------------------------------------------------------*/
+static twi_xfer_t *chained;     // Submitted by callback_submit()
+static uint8_t callbacks;
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+    twi_init();
+    chained = NULL;
+    callbacks = 0;
+}
+
+
+void tearDown(void)
+{
+    // Every test must finish its transactions, the queue is static
+    TEST_ASSERT_EQUAL_UINT8(0, twi_busy());
+}
+
+
+/* Run TWI interrupt with the given status code */
+static void step(uint8_t status)
+{
+    TWSR = status;
+    TWI_vect();
+}
+
+
+static void callback_count(twi_xfer_t *xfer)
+{
+    callbacks++;
+}
+
+
+static void callback_submit(twi_xfer_t *xfer)
+{
+    uint8_t twcr = TWCR;
+
+    // START is generated by twi_finish() together with STOP afterwards
+    callbacks++;
+    TEST_ASSERT_EQUAL_UINT8(0, twi_submit(chained));
+    TEST_ASSERT_EQUAL_HEX8(twcr, TWCR);
+}
+
+
+void test_set_frequency_never_exceeds_request(void)
+{
+    twi_set_frequency(TWI_FREQ_STANDARD);
+    TEST_ASSERT_EQUAL_UINT8(72, TWBR);
+    TEST_ASSERT_EQUAL_UINT8(0, TWSR & 0x03);
+    TEST_ASSERT_EQUAL_UINT16(90 + TWI_STRETCH_US, twi_timeout_us);
+
+    twi_set_frequency(TWI_FREQ_FAST);
+    TEST_ASSERT_EQUAL_UINT8(12, TWBR);
+
+    // 12 would give 400 kHz, 13 gives 381 kHz
+    twi_set_frequency(395000);
+    TEST_ASSERT_EQUAL_UINT8(13, TWBR);
+
+    // Prescaler 64, one byte takes 18 ms
+    twi_set_frequency(500);
+    TEST_ASSERT_EQUAL_UINT8(250, TWBR);
+    TEST_ASSERT_EQUAL_UINT8(3, TWSR & 0x03);
+    TEST_ASSERT_EQUAL_UINT16(18009 + TWI_STRETCH_US, twi_timeout_us);
+}
+
+
+void test_read_reports_unexpected_status(void)
+{
+    TWDR = 0x42;
+    TWSR = 0x58;
+    TEST_ASSERT_EQUAL_HEX8(0x42, twi_read_nack());
+    TEST_ASSERT_EQUAL_UINT8(TWI_OK, twi_error());
+
+    TWSR = 0x50;
+    twi_read_ack();
+    TEST_ASSERT_EQUAL_UINT8(TWI_OK, twi_error());
+
+    // Arbitration lost instead of data byte
+    TWSR = 0x38;
+    twi_read_nack();
+    TEST_ASSERT_EQUAL_UINT8(TWI_ERR_READ, twi_error());
+}
+
+
+void test_write_then_read_transaction(void)
+{
+    const uint8_t tx[2] = {0x01, 0x02};
+    uint8_t rx[2] = {0, 0};
+    twi_xfer_t xfer = {SLA, tx, 2, rx, 2, callback_count, 0};
+
+    TEST_ASSERT_EQUAL_UINT8(0, twi_submit(&xfer));
+    TEST_ASSERT_EQUAL_HEX8(TWCR_START, TWCR);
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_BUSY, xfer.status);
+
+    step(0x08);                             // START
+    TEST_ASSERT_EQUAL_HEX8((SLA << 1) | TWI_WRITE, TWDR);
+    step(0x18);                             // SLA+W, ACK
+    TEST_ASSERT_EQUAL_HEX8(0x01, TWDR);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_NEXT, TWCR);
+    step(0x28);                             // Data, ACK
+    TEST_ASSERT_EQUAL_HEX8(0x02, TWDR);
+    step(0x28);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_START, TWCR);
+
+    step(0x10);                             // Repeated START
+    TEST_ASSERT_EQUAL_HEX8((SLA << 1) | TWI_READ, TWDR);
+    step(0x40);                             // SLA+R, ACK
+    TEST_ASSERT_EQUAL_HEX8(TWCR_NEXT | _BV(TWEA), TWCR);
+    TWDR = 0xa5;
+    step(0x50);                             // Data, ACK returned
+    TEST_ASSERT_EQUAL_HEX8(TWCR_NEXT, TWCR);
+    TWDR = 0x5a;
+    step(0x58);                             // Data, NACK returned
+
+    TEST_ASSERT_EQUAL_HEX8(0xa5, rx[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, rx[1]);
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_OK, xfer.status);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_STOP, TWCR);
+    TEST_ASSERT_EQUAL_UINT8(1, callbacks);
+}
+
+
+void test_address_nack_finishes_with_status(void)
+{
+    const uint8_t tx[1] = {0x00};
+    twi_xfer_t xfer = {SLA, tx, 1, NULL, 0, NULL, 0};
+
+    twi_submit(&xfer);
+    step(0x08);
+    step(0x20);                             // SLA+W, NACK
+
+    TEST_ASSERT_EQUAL_HEX8(0x20, xfer.status);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_STOP, TWCR);
+}
+
+
+void test_callback_submits_next_transaction(void)
+{
+    const uint8_t tx[1] = {0x10};
+    twi_xfer_t second = {SLA + 1, tx, 1, NULL, 0, callback_count, 0};
+    twi_xfer_t first = {SLA, tx, 1, NULL, 0, callback_submit, 0};
+
+    chained = &second;
+    twi_submit(&first);
+    step(0x08);
+    step(0x18);
+    step(0x28);
+
+    // STOP of the first one followed by START of the second one
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_OK, first.status);
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_BUSY, second.status);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_STOP_START, TWCR);
+
+    step(0x08);
+    TEST_ASSERT_EQUAL_HEX8(((SLA + 1) << 1) | TWI_WRITE, TWDR);
+    step(0x18);
+    step(0x28);
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_OK, second.status);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_STOP, TWCR);
+    TEST_ASSERT_EQUAL_UINT8(2, callbacks);
+}
+
+
+void test_submit_during_stop_keeps_it(void)
+{
+    const uint8_t tx[1] = {0x00};
+    twi_xfer_t first = {SLA, tx, 1, NULL, 0, NULL, 0};
+    twi_xfer_t second = {SLA + 1, tx, 1, NULL, 0, NULL, 0};
+
+    twi_submit(&first);
+    step(0x08);
+    step(0x18);
+    step(0x28);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_STOP, TWCR);
+
+    // TWSTO is still set, STOP has not been transmitted yet
+    twi_submit(&second);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_STOP_START, TWCR);
+    step(0x08);
+    step(0x20);
+    TEST_ASSERT_EQUAL_HEX8(0x20, second.status);
+
+    // Bus is idle, only START is generated
+    TWCR = _BV(TWEN);
+    twi_submit(&first);
+    TEST_ASSERT_EQUAL_HEX8(TWCR_START, TWCR);
+    step(0x08);
+    step(0x20);
+}
+
+
+void test_stalled_transaction_waits_for_recover(void)
+{
+    const uint8_t tx[1] = {0x00};
+    twi_xfer_t first = {SLA, tx, 1, NULL, 0, callback_count, 0};
+    twi_xfer_t second = {SLA + 1, tx, 1, NULL, 0, NULL, 0};
+    twi_xfer_t third = {SLA + 2, tx, 1, NULL, 0, NULL, 0};
+
+    twi_submit(&first);
+    twi_submit(&second);
+    step(0x08);
+    twi_tick();
+    twi_tick();                             // No TWI interrupt since
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_TIMEOUT, first.status);
+    TEST_ASSERT_EQUAL_UINT8(1, callbacks);
+    TEST_ASSERT_EQUAL_UINT8(1, twi_stalled());
+
+    // TWI unit stays disconnected, nothing is started from interrupt
+    TEST_ASSERT_EQUAL_HEX8(0, TWCR);
+    twi_tick();
+    twi_submit(&third);
+    TEST_ASSERT_EQUAL_HEX8(0, TWCR);
+    TEST_ASSERT_EQUAL_HEX8(TWI_XFER_BUSY, second.status);
+
+    // Main loop releases the bus and the queue continues
+    twi_recover();
+    TEST_ASSERT_EQUAL_UINT8(0, twi_stalled());
+    TEST_ASSERT_EQUAL_HEX8(TWCR_START, TWCR);
+    step(0x08);
+    TEST_ASSERT_EQUAL_HEX8(((SLA + 1) << 1) | TWI_WRITE, TWDR);
+    step(0x20);
+    TEST_ASSERT_EQUAL_HEX8(0x20, second.status);
+    step(0x08);
+    step(0x20);
+    TEST_ASSERT_EQUAL_HEX8(0x20, third.status);
+}
+
+
+void test_queue_full(void)
+{
+    twi_xfer_t xfer[TWI_QUEUE_SIZE];
+    uint8_t i;
+
+    for (i = 0; i < TWI_QUEUE_SIZE; i++)
+    {
+        xfer[i] = (twi_xfer_t) {SLA, NULL, 0, NULL, 0, NULL, 0};
+        TEST_ASSERT_EQUAL_UINT8(i == TWI_QUEUE_SIZE - 1, twi_submit(&xfer[i]));
+    }
+
+    // Bus error finishes the one in progress and starts the next one
+    for (i = 0; i < TWI_QUEUE_SIZE - 1; i++)
+    {
+        step(0x00);
+        TEST_ASSERT_EQUAL_HEX8(TWI_XFER_BUS_ERROR, xfer[i].status);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_set_frequency_never_exceeds_request);
+    RUN_TEST(test_read_reports_unexpected_status);
+    RUN_TEST(test_write_then_read_transaction);
+    RUN_TEST(test_address_nack_finishes_with_status);
+    RUN_TEST(test_callback_submits_next_transaction);
+    RUN_TEST(test_submit_during_stop_keeps_it);
+    RUN_TEST(test_stalled_transaction_waits_for_recover);
+    RUN_TEST(test_queue_full);
+    return UNITY_END();
+}
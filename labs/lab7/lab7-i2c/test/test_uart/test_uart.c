@@ -0,0 +1,137 @@
+/***********************************************************************
+ *
+ * Unit tests of the interrupt driven UART library on mocked registers,
+ * run by "pio test -e native".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <uart.h>
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+    uart_init(UART_BAUD_SELECT(9600, F_CPU));
+}
+
+
+void tearDown(void)
+{
+}
+
+
+/* Receive one byte by the Receive Complete interrupt */
+static void receive(uint8_t data, uint8_t status)
+{
+    UCSR0A = status;
+    UDR0 = data;
+    USART_RX_vect();
+}
+
+
+void test_init_sets_baud_rate_and_frame(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(103, UBRR0L);
+    TEST_ASSERT_EQUAL_UINT8(0, UBRR0H);
+    TEST_ASSERT_EQUAL_UINT8(0, UCSR0A);
+    TEST_ASSERT_EQUAL_HEX8(_BV(RXCIE0) | _BV(RXEN0) | _BV(TXEN0), UCSR0B);
+    TEST_ASSERT_EQUAL_HEX8(_BV(UCSZ01) | _BV(UCSZ00), UCSR0C);
+}
+
+
+void test_rx_isr_stores_bytes_in_order(void)
+{
+    receive('a', 0);
+    receive('b', 0);
+
+    TEST_ASSERT_EQUAL_HEX16('a', uart_getc());
+    TEST_ASSERT_EQUAL_HEX16('b', uart_getc());
+    TEST_ASSERT_EQUAL_HEX16(UART_NO_DATA, uart_getc());
+}
+
+
+void test_rx_isr_reports_frame_error(void)
+{
+    receive('x', _BV(FE0));
+
+    TEST_ASSERT_EQUAL_HEX16(UART_FRAME_ERROR | 'x', uart_getc());
+    TEST_ASSERT_EQUAL_HEX16(UART_NO_DATA, uart_getc());
+}
+
+
+void test_rx_isr_reports_buffer_overflow(void)
+{
+    uint8_t i;
+
+    // One slot of the ring stays unused, the last byte is lost
+    for (i = 0; i < UART_RX_BUFFER_SIZE; i++)
+        receive('0' + i, 0);
+
+    TEST_ASSERT_EQUAL_HEX16(UART_BUFFER_OVERFLOW | '0', uart_getc());
+    for (i = 1; i < UART_RX_BUFFER_SIZE - 1; i++)
+        TEST_ASSERT_EQUAL_HEX16('0' + i, uart_getc());
+    TEST_ASSERT_EQUAL_HEX16(UART_NO_DATA, uart_getc());
+}
+
+
+void test_udre_isr_sends_bytes_in_order(void)
+{
+    uart_puts("hi");
+    TEST_ASSERT_BITS_HIGH(_BV(UDRIE0), UCSR0B);
+
+    USART_UDRE_vect();
+    TEST_ASSERT_EQUAL_CHAR('h', UDR0);
+    USART_UDRE_vect();
+    TEST_ASSERT_EQUAL_CHAR('i', UDR0);
+    TEST_ASSERT_BITS_HIGH(_BV(UDRIE0), UCSR0B);
+
+    // Empty buffer disables the interrupt and sends nothing
+    UDR0 = 0;
+    USART_UDRE_vect();
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+    TEST_ASSERT_EQUAL_UINT8(0, UDR0);
+}
+
+
+void test_write_nb_stores_only_what_fits(void)
+{
+    static uint8_t block[UART_TX_BUFFER_SIZE];
+    unsigned int i;
+
+    for (i = 0; i < sizeof(block); i++)
+        block[i] = i;
+
+    TEST_ASSERT_EQUAL_UINT(UART_TX_BUFFER_SIZE - 1, uart_write_nb(block, sizeof(block)));
+    TEST_ASSERT_EQUAL_UINT(0, uart_write_nb(block, 1));
+
+    for (i = 0; i < UART_TX_BUFFER_SIZE - 1; i++)
+    {
+        USART_UDRE_vect();
+        TEST_ASSERT_EQUAL_UINT8(block[i], UDR0);
+    }
+    USART_UDRE_vect();
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_sets_baud_rate_and_frame);
+    RUN_TEST(test_rx_isr_stores_bytes_in_order);
+    RUN_TEST(test_rx_isr_reports_frame_error);
+    RUN_TEST(test_rx_isr_reports_buffer_overflow);
+    RUN_TEST(test_udre_isr_sends_bytes_in_order);
+    RUN_TEST(test_write_nb_stores_only_what_fits);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+/***********************************************************************
+ *
+ * Unit tests of the line receive mode of the UART library on mocked
+ * registers, run by "pio test -e native_uart_modes".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <uart.h>
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+    uart_init(UART_BAUD_SELECT(9600, F_CPU));
+}
+
+
+void tearDown(void)
+{
+}
+
+
+/* Receive one byte by the Receive Complete interrupt */
+static void receive(uint8_t data, uint8_t status)
+{
+    UCSR0A = status;
+    UDR0 = data;
+    USART_RX_vect();
+}
+
+
+/* Receive string without errors */
+static void receive_str(const char *s)
+{
+    while (*s)
+        receive(*s++, 0);
+}
+
+
+void test_cr_and_lf_both_end_line(void)
+{
+    receive_str("ab\r\ncd\n");
+
+    TEST_ASSERT_EQUAL_STRING("ab", uart_getline());
+    TEST_ASSERT_EQUAL_STRING("cd", uart_getline());
+    TEST_ASSERT_NULL(uart_getline());
+    TEST_ASSERT_EQUAL_HEX16(UART_NO_DATA, uart_getc());
+}
+
+
+void test_incomplete_line_is_not_returned(void)
+{
+    receive_str("abc");
+    TEST_ASSERT_NULL(uart_getline());
+
+    receive('\r', 0);
+    TEST_ASSERT_EQUAL_STRING("abc", uart_getline());
+}
+
+
+void test_empty_lines_are_skipped(void)
+{
+    receive_str("\r\n\n\rx\r\r\n");
+
+    TEST_ASSERT_EQUAL_STRING("x", uart_getline());
+    TEST_ASSERT_NULL(uart_getline());
+}
+
+
+void test_long_line_is_truncated(void)
+{
+    char expected[UART_LINE_SIZE];
+    uint8_t i;
+
+    for (i = 0; i < UART_LINE_SIZE + 5; i++)
+        receive('a' + i % 26, 0);
+    receive('\n', 0);
+
+    for (i = 0; i < UART_LINE_SIZE - 1; i++)
+        expected[i] = 'a' + i % 26;
+    expected[i] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expected, uart_getline());
+
+    // Next line starts from the beginning of the buffer
+    receive_str("ok\n");
+    TEST_ASSERT_EQUAL_STRING("ok", uart_getline());
+}
+
+
+void test_line_with_error_is_discarded(void)
+{
+    receive_str("ab");
+    receive('c', _BV(FE0));
+    receive_str("d\r");
+    TEST_ASSERT_NULL(uart_getline());
+
+    // Overrun of the receiver discards the line as well
+    receive('e', _BV(DOR0));
+    receive_str("\rok\r");
+    TEST_ASSERT_EQUAL_STRING("ok", uart_getline());
+    TEST_ASSERT_NULL(uart_getline());
+}
+
+
+void test_next_line_waits_while_previous_is_held(void)
+{
+    char *first;
+
+    receive_str("one\r");
+    first = uart_getline();
+    TEST_ASSERT_EQUAL_STRING("one", first);
+
+    // Second buffer is complete, the held line is not overwritten
+    receive_str("two\r");
+    TEST_ASSERT_EQUAL_STRING("one", first);
+
+    // Both buffers occupied, the third line is lost
+    receive_str("three\r");
+    TEST_ASSERT_EQUAL_STRING("one", first);
+
+    // Releasing the first line returns the second one
+    TEST_ASSERT_EQUAL_STRING("two", uart_getline());
+    TEST_ASSERT_NULL(uart_getline());
+
+    receive_str("four\n");
+    TEST_ASSERT_EQUAL_STRING("four", uart_getline());
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cr_and_lf_both_end_line);
+    RUN_TEST(test_incomplete_line_is_not_returned);
+    RUN_TEST(test_empty_lines_are_skipped);
+    RUN_TEST(test_long_line_is_truncated);
+    RUN_TEST(test_line_with_error_is_discarded);
+    RUN_TEST(test_next_line_waits_while_previous_is_held);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+/***********************************************************************
+ *
+ * Unit tests of the ping-pong transmit buffers of the UART library on
+ * mocked registers, run by "pio test -e native_uart_modes".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <uart.h>
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+    uart_init(UART_BAUD_SELECT(9600, F_CPU));
+}
+
+
+void tearDown(void)
+{
+}
+
+
+/* Run Data Register Empty interrupt and return the transmitted byte */
+static uint8_t transmit(void)
+{
+    UDR0 = 0;
+    USART_UDRE_vect();
+    return UDR0;
+}
+
+
+/* Fill ping-pong buffer by string and return its length */
+static uint8_t fill(unsigned char *buf, const char *s)
+{
+    uint8_t len = 0;
+
+    while (*s)
+        buf[len++] = *s++;
+    return len;
+}
+
+
+void test_swap_returns_the_other_buffer(void)
+{
+    unsigned char *first = uart_pp_buffer();
+    unsigned char *next;
+
+    // Nothing written yet, the same buffer is filled further
+    TEST_ASSERT_TRUE(uart_pp_swap(0) == first);
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+
+    next = uart_pp_swap(fill(first, "ab"));
+    TEST_ASSERT_TRUE(next != first);
+    TEST_ASSERT_TRUE(uart_pp_buffer() == next);
+    TEST_ASSERT_BITS_HIGH(_BV(UDRIE0), UCSR0B);
+
+    TEST_ASSERT_EQUAL_CHAR('a', transmit());
+    TEST_ASSERT_EQUAL_CHAR('b', transmit());
+}
+
+
+void test_udre_sends_block_then_ring(void)
+{
+    uart_pp_swap(fill(uart_pp_buffer(), "abc"));
+    TEST_ASSERT_EQUAL_CHAR('a', transmit());
+
+    // Block in progress is finished before the ringbuffer
+    uart_puts("xy");
+    TEST_ASSERT_EQUAL_CHAR('b', transmit());
+    TEST_ASSERT_EQUAL_CHAR('c', transmit());
+    TEST_ASSERT_EQUAL_CHAR('x', transmit());
+    TEST_ASSERT_EQUAL_CHAR('y', transmit());
+
+    // Nothing left, the interrupt disables itself
+    TEST_ASSERT_BITS_HIGH(_BV(UDRIE0), UCSR0B);
+    transmit();
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+}
+
+
+void test_block_waits_for_empty_ring(void)
+{
+    // Bytes written to the ringbuffer at once are not split by a block
+    uart_puts("xy");
+    uart_pp_swap(fill(uart_pp_buffer(), "ab"));
+
+    TEST_ASSERT_EQUAL_CHAR('x', transmit());
+    TEST_ASSERT_EQUAL_CHAR('y', transmit());
+    TEST_ASSERT_EQUAL_CHAR('a', transmit());
+    TEST_ASSERT_EQUAL_CHAR('b', transmit());
+}
+
+
+void test_swap_before_block_is_sent_counts_overrun(void)
+{
+    unsigned char *first = uart_pp_buffer();
+    unsigned char *second = uart_pp_swap(fill(first, "ab"));
+
+    // First block not sent yet, the second one is discarded
+    TEST_ASSERT_TRUE(uart_pp_swap(fill(second, "cd")) == second);
+    TEST_ASSERT_TRUE(uart_pp_swap(fill(second, "ef")) == second);
+    TEST_ASSERT_EQUAL_UINT(2, uart_pp_overruns());
+    TEST_ASSERT_EQUAL_UINT(0, uart_pp_overruns());
+
+    TEST_ASSERT_EQUAL_CHAR('a', transmit());
+    TEST_ASSERT_TRUE(uart_pp_swap(fill(second, "gh")) == second);
+    TEST_ASSERT_EQUAL_CHAR('b', transmit());
+
+    // First block sent, buffers are swapped
+    TEST_ASSERT_TRUE(uart_pp_swap(fill(second, "ij")) == first);
+    TEST_ASSERT_EQUAL_UINT(1, uart_pp_overruns());
+    TEST_ASSERT_EQUAL_CHAR('i', transmit());
+    TEST_ASSERT_EQUAL_CHAR('j', transmit());
+}
+
+
+void test_buffers_alternate_in_continuous_stream(void)
+{
+    unsigned char *buf = uart_pp_buffer();
+    uint8_t block;
+    uint8_t i;
+
+    // Producer fills one block while the previous one is being sent
+    for (i = 0; i < 4; i++)
+        buf[i] = 'a';
+    buf = uart_pp_swap(4);
+    for (block = 1; block < 8; block++)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            buf[i] = 'a' + block;
+            TEST_ASSERT_EQUAL_CHAR('a' + block - 1, transmit());
+        }
+        buf = uart_pp_swap(4);
+    }
+    TEST_ASSERT_EQUAL_UINT(0, uart_pp_overruns());
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_swap_returns_the_other_buffer);
+    RUN_TEST(test_udre_sends_block_then_ring);
+    RUN_TEST(test_block_waits_for_empty_ring);
+    RUN_TEST(test_swap_before_block_is_sent_counts_overrun);
+    RUN_TEST(test_buffers_alternate_in_continuous_stream);
+    return UNITY_END();
+}
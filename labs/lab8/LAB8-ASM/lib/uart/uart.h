@@ -38,7 +38,8 @@
  *  for buffering received and transmitted data.
  *
  *  The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE constants define
- *  the size of the circular buffers in bytes. Note that these constants must be a power of 2.
+ *  the size of the circular buffers in bytes. Note that these constants must be a power of 2
+ *  from 2 to 256.
  *  You may need to adapt these constants to your target and your application by adding
  *  CDEFS += -DUART_RX_BUFFER_SIZE=nn -DUART_TX_BUFFER_SIZE=nn to your Makefile.
  *
@@ -75,10 +76,57 @@
  */
 #define UART_BAUD_SELECT_DOUBLE_SPEED(baudRate, xtalCpu) ( ((((xtalCpu) + 4UL * (baudRate)) / (8UL * (baudRate)) - 1UL)) | 0x8000)
 
+/** @brief  Maximal accepted baudrate error in 0.1 % used by UART_BAUD_AUTO, default 2 % */
+#ifndef UART_BAUD_TOL
+# define UART_BAUD_TOL 20
+#endif
+
+#if defined(UART_BAUD) || defined(__DOXYGEN__)
+/* baudrate error in 0.1 % of normal (16 samples) and double speed (8 samples) mode */
+# define UART_BAUD_ERROR_RATE(baudRate, xtalCpu, samples, ubrr) \
+    ((xtalCpu) * 1000 / ((samples) * ((ubrr) + 1)) / (baudRate))
+# define UART_UBRR_NORMAL ((F_CPU + 8UL * UART_BAUD) / (16UL * UART_BAUD) - 1UL)
+# define UART_UBRR_DOUBLE ((F_CPU + 4UL * UART_BAUD) / (8UL * UART_BAUD) - 1UL)
+# define UART_RATE_NORMAL UART_BAUD_ERROR_RATE(UART_BAUD, F_CPU, 16UL, UART_UBRR_NORMAL)
+# define UART_RATE_DOUBLE UART_BAUD_ERROR_RATE(UART_BAUD, F_CPU, 8UL, UART_UBRR_DOUBLE)
+# if UART_RATE_NORMAL > 1000
+#  define UART_ERROR_NORMAL (UART_RATE_NORMAL - 1000)
+# else
+#  define UART_ERROR_NORMAL (1000 - UART_RATE_NORMAL)
+# endif
+# if UART_RATE_DOUBLE > 1000
+#  define UART_ERROR_DOUBLE (UART_RATE_DOUBLE - 1000)
+# else
+#  define UART_ERROR_DOUBLE (1000 - UART_RATE_DOUBLE)
+# endif
+
+/** @brief  UART Baudrate Expression for baudrate UART_BAUD with the lower error
+ *
+ *  Select the baudrate by adding build_flags = -DUART_BAUD=nn to platformio.ini
+ *  (or CDEFS += -DUART_BAUD=nn to your Makefile) and use uart_init(UART_BAUD_AUTO).
+ *  Normal or double speed mode is chosen at compile time, whichever is closer
+ *  to UART_BAUD, normal mode on a tie. The build fails when the error is larger
+ *  than UART_BAUD_TOL, e.g. 115200 Bd at 16 MHz (2.1 %). 250000, 500000 and
+ *  1000000 Bd are exact at 16 MHz.
+ */
+# if UART_ERROR_DOUBLE < UART_ERROR_NORMAL
+#  define UART_BAUD_AUTO  UART_BAUD_SELECT_DOUBLE_SPEED(UART_BAUD, F_CPU)
+#  define UART_BAUD_ERROR UART_ERROR_DOUBLE /**< @brief baudrate error of UART_BAUD_AUTO in 0.1 % */
+# else
+#  define UART_BAUD_AUTO  UART_BAUD_SELECT(UART_BAUD, F_CPU)
+#  define UART_BAUD_ERROR UART_ERROR_NORMAL /**< @brief baudrate error of UART_BAUD_AUTO in 0.1 % */
+# endif
+# if UART_BAUD_ERROR > UART_BAUD_TOL
+#  error "UART_BAUD can not be reached within UART_BAUD_TOL, choose other baudrate"
+# endif
+#endif /* if defined(UART_BAUD) */
+
 /** @brief  Size of the circular receive buffer, must be power of 2
  *
  *  You may need to adapt this constant to your target and your application by adding
- *  CDEFS += -DUART_RX_BUFFER_SIZE=nn to your Makefile.
+ *  CDEFS += -DUART_RX_BUFFER_SIZE=nn to your Makefile, or
+ *  build_flags = -DUART_RX_BUFFER_SIZE=nn to platformio.ini.
+ *  Maximal size is 256, such buffer wraps around without index masking.
  */
 #ifndef UART_RX_BUFFER_SIZE
 # define UART_RX_BUFFER_SIZE 64
@@ -87,12 +135,73 @@
 /** @brief  Size of the circular transmit buffer, must be power of 2
  *
  *  You may need to adapt this constant to your target and your application by adding
- *  CDEFS += -DUART_TX_BUFFER_SIZE=nn to your Makefile.
+ *  CDEFS += -DUART_TX_BUFFER_SIZE=nn to your Makefile, or
+ *  build_flags = -DUART_TX_BUFFER_SIZE=nn to platformio.ini.
+ *  Maximal size is 256, such buffer wraps around without index masking.
  */
 #ifndef UART_TX_BUFFER_SIZE
 # define UART_TX_BUFFER_SIZE 64
 #endif
 
+/*
+** transmit policy when the circular transmit buffer is full
+*/
+#define UART_TX_BLOCK     0 /**< @brief wait for free space in buffer       */
+#define UART_TX_DROP      1 /**< @brief discard the new byte                */
+#define UART_TX_OVERWRITE 2 /**< @brief discard the oldest byte not sent yet */
+
+/** @brief  Behaviour of uart_putc(), uart_puts() and uart_write() with full transmit buffer
+ *
+ *  UART_TX_BLOCK waits until the transmit interrupt frees a slot. It must
+ *  not be used from ISR, where the transmit interrupt cannot run.
+ *  With UART_TX_DROP or UART_TX_OVERWRITE the functions never wait and
+ *  the discarded bytes are counted, see uart_tx_dropped().
+ *  Add CDEFS += -DUART_TX_POLICY=UART_TX_DROP to your Makefile.
+ */
+#ifndef UART_TX_POLICY
+# define UART_TX_POLICY UART_TX_BLOCK
+#endif
+
+/** @brief  Receive whole lines instead of single bytes
+ *
+ *  With UART_RX_LINE_MODE set to 1, the receive interrupt assembles
+ *  characters into one of two line buffers. CR or LF completes the line,
+ *  empty lines are skipped and lines longer than UART_LINE_SIZE - 1 are
+ *  truncated. Complete lines are read by uart_getline(), uart_getc()
+ *  returns UART_NO_DATA in this mode.
+ */
+#ifndef UART_RX_LINE_MODE
+# define UART_RX_LINE_MODE 0
+#endif
+
+/** @brief  Size of one line buffer including terminating null character */
+#ifndef UART_LINE_SIZE
+# define UART_LINE_SIZE 32
+#endif
+
+/** @brief  Transmit blocks from two alternating buffers besides the ringbuffer
+ *
+ *  With UART_TX_PINGPONG set to 1, a producer such as an ADC interrupt fills
+ *  one buffer directly while the transmit interrupt drains the other one,
+ *  see uart_pp_swap(). A block starts only when the ringbuffer is empty and
+ *  is then sent as a whole, so neither a block nor data written to the
+ *  ringbuffer at once, e.g. a frame by uart_write(), is split by the other.
+ */
+#ifndef UART_TX_PINGPONG
+# define UART_TX_PINGPONG 0
+#endif
+
+/** @brief  Size of one ping-pong transmit buffer, from 1 to 255
+ *
+ *  Default 64 bytes hold 32 samples of 10-bit ADC sent as 2 bytes. At
+ *  1 Mbd (UART_BAUD=1000000, exact at 16 MHz) one buffer is drained in
+ *  640 us, which supports continuous streaming of up to 50 000 samples/s,
+ *  e.g. free running ADC with prescaler 32 (38 500 samples/s).
+ */
+#ifndef UART_PP_BUFFER_SIZE
+# define UART_PP_BUFFER_SIZE 64
+#endif
+
 /* test if the size of the circular buffers fits into SRAM */
 #if ( (UART_RX_BUFFER_SIZE + UART_TX_BUFFER_SIZE) >= (RAMEND - 0x60 ) )
 # error "size of UART_RX_BUFFER_SIZE + UART_TX_BUFFER_SIZE larger than size of SRAM"
@@ -147,6 +256,19 @@ extern void uart_init(unsigned int baudrate);
 extern unsigned int uart_getc(void);
 
 
+/**
+ *  @brief   Get next complete line received by UART (UART_RX_LINE_MODE only)
+ *
+ *  The interrupt assembles the next line into the second buffer meanwhile.
+ *  When the second line is complete before the first one is released,
+ *  further characters are dropped until the next call.
+ *
+ *  @return  received line without CR/LF, valid until the next call of
+ *           uart_getline(), or NULL if no complete line is available
+ */
+extern char *uart_getline(void);
+
+
 /**
  *  @brief   Put byte to ringbuffer for transmitting via UART
  *  @param   data byte to be transmitted
@@ -163,11 +285,85 @@ extern void uart_putc(unsigned char data);
  *  Blocks if it can not write the whole string into the circular buffer.
  *
  *  @param   s string to be transmitted
+ *  @see     uart_write
  *  @return  none
  */
 extern void uart_puts(const char *s);
 
 
+/**
+ *  @brief   Get number of transmitted bytes discarded due to full ringbuffer
+ *
+ *  The counter is cleared by each call. It is always 0 with UART_TX_BLOCK policy.
+ *
+ *  @return  number of bytes discarded since the last call
+ *  @see     UART_TX_POLICY
+ */
+extern unsigned int uart_tx_dropped(void);
+
+
+/**
+ *  @brief   Put block of bytes to ringbuffer for transmitting via UART
+ *
+ *  Free space of the circular buffer is computed once, all bytes that
+ *  fit are copied and the transmit interrupt is enabled once.
+ *  Blocks until the whole block is written into the circular buffer,
+ *  unless UART_TX_POLICY allows to discard data.
+ *
+ *  @param   buf data to be transmitted
+ *  @param   len number of bytes
+ *  @return  none
+ */
+extern void uart_write(const void *buf, unsigned int len);
+
+
+/**
+ *  @brief   Put block of bytes to ringbuffer without waiting
+ *
+ *  Copies only the bytes that fit into the circular buffer at the moment,
+ *  so the call takes bounded time and can be used e.g. in ISR.
+ *
+ *  @param   buf data to be transmitted
+ *  @param   len number of bytes
+ *  @return  number of bytes written into the circular buffer
+ */
+extern unsigned int uart_write_nb(const void *buf, unsigned int len);
+
+
+/**
+ *  @brief   Get the ping-pong buffer to be filled first (UART_TX_PINGPONG only)
+ *  @return  buffer of UART_PP_BUFFER_SIZE bytes
+ */
+extern unsigned char *uart_pp_buffer(void);
+
+
+/**
+ *  @brief   Pass filled ping-pong buffer to transmit interrupt (UART_TX_PINGPONG only)
+ *
+ *  Takes constant time, so it can be called from the producing ISR, e.g.
+ *  when ADC interrupt stores the last sample to the buffer. If the transmit
+ *  interrupt has not finished the previous block yet, the UART is too slow
+ *  for the data stream: the block is discarded, the overrun counter is
+ *  incremented and the same buffer is returned to be filled again.
+ *
+ *  @param   len number of bytes written to the buffer, 0 to keep filling it
+ *  @return  buffer of UART_PP_BUFFER_SIZE bytes to be filled next
+ *  @see     uart_pp_overruns
+ */
+extern unsigned char *uart_pp_swap(unsigned char len);
+
+
+/**
+ *  @brief   Get number of ping-pong blocks discarded because the previous
+ *           block was still being transmitted (UART_TX_PINGPONG only)
+ *
+ *  The counter is cleared by each call.
+ *
+ *  @return  number of blocks discarded since the last call
+ */
+extern unsigned int uart_pp_overruns(void);
+
+
 /**
  * @brief    Put string from program memory to ringbuffer for transmitting via UART.
  *
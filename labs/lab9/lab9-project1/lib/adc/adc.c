@@ -0,0 +1,311 @@
+/***********************************************************************
+ *
+ * Auto-triggered multi-channel ADC sampling with ring buffers.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/interrupt.h>  // Interrupts standard C library for AVR-GCC
+#include <util/atomic.h>    // Atomically executed code blocks
+#include <ring.h>           // Lock-free ring buffer
+#include <adc.h>
+#if ISRSTAT
+# include <isrstat.h>       // ISR execution time statistics, -DISRSTAT=1
+#else
+# define ISRSTAT_ENTER(id)
+# define ISRSTAT_EXIT(id)
+#endif
+#ifndef F_CPU
+# define F_CPU 16000000
+#endif
+
+
+/* Defines -----------------------------------------------------------*/
+// Maximal compare value of the rate timer
+#if ADC_RATE_TIMER == 1
+# define ADC_RATE_TOP 0xffffUL
+#else
+# define ADC_RATE_TOP 0xffUL
+#endif
+
+
+/* Types -------------------------------------------------------------*/
+// Ring buffer of samples adc_ring_t
+RING_DEFINE(adc_ring, uint16_t, ADC_RING_SIZE)
+
+
+/* Variables ---------------------------------------------------------*/
+static uint8_t adc_channel[ADC_CHANNELS_MAX];   // Channel list, MUX bits
+static uint8_t adc_count;                       // Number of channels in list
+static uint8_t adc_free;                        // Nonzero in free running mode
+static uint8_t adc_conv;                        // List index of the running conversion
+static uint8_t adc_mux;                         // List index selected in ADMUX
+
+// Flag of the trigger source, cleared by ADC interrupt when the timer
+// interrupt does not do it
+static volatile uint8_t *adc_tifr;
+static volatile uint8_t *adc_timsk;
+static uint8_t adc_tmask;
+
+static adc_ring_t adc_ring[ADC_CHANNELS_MAX];
+static volatile unsigned int adc_overrun;
+#if ADC_OVERSAMPLE
+static uint32_t adc_sum[ADC_CHANNELS_MAX];      // Sum of conversions being decimated
+static uint8_t adc_sum_count[ADC_CHANNELS_MAX]; // Number of conversions in adc_sum
+#endif
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: adc_init()
+ * Purpose:  Configure ADC and start sampling of the channel list.
+ * Input(s): channels - Channel numbers (MUX bits)
+ *           count - Number of channels
+ *           trigger - ADC Auto Trigger Source (ADTS bits)
+ * Returns:  none
+ **********************************************************************/
+void adc_init(const uint8_t *channels, uint8_t count, uint8_t trigger)
+{
+    uint8_t i;
+
+    // Stop ADC before the configuration is changed
+    ADCSRA = 0;
+
+    if (count > ADC_CHANNELS_MAX)
+        count = ADC_CHANNELS_MAX;
+    for (i = 0; i < count; i++)
+    {
+        adc_channel[i] = channels[i] & 0x0f;
+        adc_ring_init(&adc_ring[i]);
+#if ADC_OVERSAMPLE
+        adc_sum[i] = 0;
+        adc_sum_count[i] = 0;
+#endif
+    }
+    adc_count = count;
+    adc_overrun = 0;
+    adc_conv = 0;
+    adc_mux = 0;
+    ADMUX = ADC_REFERENCE | adc_channel[0];
+
+    adc_tifr = 0;
+    switch (trigger)
+    {
+    case ADC_TRIGGER_TIM0_COMPA:
+        adc_tifr = &TIFR0;
+        adc_timsk = &TIMSK0;
+        adc_tmask = (1<<OCF0A);
+        break;
+    case ADC_TRIGGER_TIM0_OVF:
+        adc_tifr = &TIFR0;
+        adc_timsk = &TIMSK0;
+        adc_tmask = (1<<TOV0);
+        break;
+    case ADC_TRIGGER_TIM1_COMPB:
+        adc_tifr = &TIFR1;
+        adc_timsk = &TIMSK1;
+        adc_tmask = (1<<OCF1B);
+        break;
+    case ADC_TRIGGER_TIM1_OVF:
+        adc_tifr = &TIFR1;
+        adc_timsk = &TIMSK1;
+        adc_tmask = (1<<TOV1);
+        break;
+    default:
+        trigger = ADC_TRIGGER_FREE;
+        break;
+    }
+    adc_free = (trigger == ADC_TRIGGER_FREE);
+
+    // Conversion is started by rising edge of the flag, clear it now
+    if (adc_tifr)
+        *adc_tifr = adc_tmask;
+
+    ADCSRB = (ADCSRB & ~((1<<ADTS2) | (1<<ADTS1) | (1<<ADTS0))) | trigger;
+    ADCSRA = (1<<ADEN) | (1<<ADATE) | (1<<ADIE) | ADC_PRESCALER;
+    if (adc_free)
+        ADCSRA |= (1<<ADSC);    // First conversion, the next ones follow
+}
+
+
+/**********************************************************************
+ * Function: adc_init_rate()
+ * Purpose:  Sample the channel list at fixed rate triggered by compare
+ *           match of ADC_RATE_TIMER in CTC mode.
+ * Input(s): channels - Channel numbers (MUX bits)
+ *           count - Number of channels
+ *           rate - Samples per second of each channel
+ * Returns:  none
+ **********************************************************************/
+void adc_init_rate(const uint8_t *channels, uint8_t count, uint16_t rate)
+{
+    // Timer prescalers selected by clock select bits 1 to 5
+    static const uint16_t prescaler[] = {1, 8, 64, 256, 1024};
+    uint32_t ticks;
+    uint32_t top;
+    uint8_t cs;
+
+    if (count == 0)
+        count = 1;
+    if (count > ADC_CHANNELS_MAX)
+        count = ADC_CHANNELS_MAX;
+    if (rate == 0)
+        rate = 1;
+
+    // The smallest prescaler gives the finest rate resolution
+    ticks = F_CPU / ((uint32_t) rate * count * ADC_OVERSAMPLE_COUNT);
+    for (cs = 0; cs < 4; cs++)
+    {
+        if (ticks / prescaler[cs] <= ADC_RATE_TOP + 1)
+            break;
+    }
+    top = (ticks + prescaler[cs] / 2) / prescaler[cs];
+    if (top > ADC_RATE_TOP + 1)
+        top = ADC_RATE_TOP + 1;
+    if (top == 0)
+        top = 1;
+
+#if ADC_RATE_TIMER == 1
+    // Timer/Counter1 in CTC mode 4, TOP = OCR1A, compare match B at TOP
+    TCCR1B = 0;
+    TCCR1A = 0;
+    TCNT1 = 0;
+    OCR1A = top - 1;
+    OCR1B = top - 1;
+    adc_init(channels, count, ADC_TRIGGER_TIM1_COMPB);
+    TCCR1B = (1<<WGM12) | (cs + 1);
+#else
+    // Timer/Counter0 in CTC mode 2, TOP = OCR0A
+    TCCR0B = 0;
+    TCCR0A = (1<<WGM01);
+    TCNT0 = 0;
+    OCR0A = top - 1;
+    adc_init(channels, count, ADC_TRIGGER_TIM0_COMPA);
+    TCCR0B = cs + 1;
+#endif
+}
+
+
+/**********************************************************************
+ * Function: adc_available()
+ * Purpose:  Get number of samples waiting in ring buffer.
+ * Input(s): index - Position of the channel in the list
+ * Returns:  Number of samples
+ **********************************************************************/
+uint8_t adc_available(uint8_t index)
+{
+    return adc_ring_count(&adc_ring[index]);
+}
+
+
+/**********************************************************************
+ * Function: adc_get()
+ * Purpose:  Read the oldest sample from ring buffer.
+ * Input(s): index - Position of the channel in the list
+ *           value - Destination of the sample
+ * Returns:  1 if a sample was read, 0 if ring buffer is empty
+ **********************************************************************/
+uint8_t adc_get(uint8_t index, uint16_t *value)
+{
+    return adc_ring_pop(&adc_ring[index], value);
+}
+
+
+/**********************************************************************
+ * Function: adc_millivolts()
+ * Purpose:  Convert sample to voltage in millivolts.
+ * Input(s): value - Sample with ADC_BITS resolution
+ *           vref_mv - Voltage reference in millivolts
+ * Returns:  Input voltage in millivolts
+ **********************************************************************/
+uint16_t adc_millivolts(uint16_t value, uint16_t vref_mv)
+{
+    // V = value * Vref / 2^ADC_BITS, max. 16383 * 65535 fits 32 bits
+    return ((uint32_t) value * vref_mv + (1UL << (ADC_BITS - 1))) >> ADC_BITS;
+}
+
+
+/**********************************************************************
+ * Function: adc_overruns()
+ * Purpose:  Get and clear number of discarded samples.
+ * Returns:  Number of samples discarded since the last call
+ **********************************************************************/
+unsigned int adc_overruns(void)
+{
+    unsigned int overruns;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        overruns = adc_overrun;
+        adc_overrun = 0;
+    }
+    return overruns;
+}
+
+
+/**********************************************************************
+ * Function: adc_put()
+ * Purpose:  Store sample to ring buffer, called from ADC interrupt.
+ * Input(s): i - Position of the channel in the list
+ *           value - Sample
+ * Returns:  none
+ **********************************************************************/
+static inline void adc_put(uint8_t i, uint16_t value)
+{
+    if (!adc_ring_push(&adc_ring[i], value))
+        adc_overrun++;
+}
+
+
+/* Interrupt service routines ----------------------------------------*/
+/**********************************************************************
+ * Function: ADC complete interrupt
+ * Purpose:  Store the result to ring buffer of its channel, or add it
+ *           to the decimated sum, and select the next channel of the
+ *           list.
+ **********************************************************************/
+ISR(ADC_vect)
+{
+    ISRSTAT_ENTER(ISRSTAT_ADC);
+    uint16_t value = ADC;
+    uint8_t i = adc_conv;
+
+    if (adc_tifr && !(*adc_timsk & adc_tmask))
+        *adc_tifr = adc_tmask;
+
+#if ADC_OVERSAMPLE
+    adc_sum[i] += value;
+    if (++adc_sum_count[i] == (uint8_t) ADC_OVERSAMPLE_COUNT)
+    {
+        // 4^n conversions give n extra bits, 256 wraps to 0 in uint8_t
+        adc_put(i, adc_sum[i] >> ADC_OVERSAMPLE);
+        adc_sum[i] = 0;
+        adc_sum_count[i] = 0;
+    }
+#else
+    adc_put(i, value);
+#endif
+
+    if (adc_free)
+    {
+        // Next conversion has already started with the channel in
+        // ADMUX, new selection is used by the one after it
+        adc_conv = adc_mux;
+        if (++adc_mux >= adc_count)
+            adc_mux = 0;
+    }
+    else
+    {
+        // Next conversion starts by the next trigger
+        if (++adc_conv >= adc_count)
+            adc_conv = 0;
+        adc_mux = adc_conv;
+    }
+    ADMUX = ADC_REFERENCE | adc_channel[adc_mux];
+    ISRSTAT_EXIT(ISRSTAT_ADC);
+}
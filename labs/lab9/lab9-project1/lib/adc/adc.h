@@ -0,0 +1,190 @@
+#ifndef ADC_H
+# define ADC_H
+
+/***********************************************************************
+ *
+ * Auto-triggered multi-channel ADC sampling with ring buffers.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @defgroup adc ADC Sampling Library <adc.h>
+ * @code #include <adc.h> @endcode
+ *
+ * @brief Auto-triggered conversions of a list of ADC channels stored
+ *        to one ring buffer per channel.
+ *
+ * The library owns ADC_vect. Conversions are started by hardware,
+ * either back to back (free running) or by a timer event selected by
+ * ADC Auto Trigger Source. Each conversion complete interrupt stores
+ * the result to the ring buffer of its channel and selects the next
+ * channel of the list, so no code has to start conversions or switch
+ * ADMUX. The sample instant is given by hardware only, so it has no
+ * jitter from interrupt latency. The main loop reads the samples by
+ * adc_get():
+ * @code
+ * static const uint8_t channels[] = {0, 1};  // ADC0 and ADC1
+ * uint16_t value;
+ *
+ * adc_init_rate(channels, 2, 500);            // 500 samples/s of each channel
+ * sei();
+ * while (1)
+ * {
+ *     while (adc_get(0, &value))
+ *     {
+ *         // process sample of ADC0
+ *     }
+ * }
+ * @endcode
+ *
+ * Every ring buffer has one producer (the interrupt) and one consumer
+ * (the caller of adc_get()), so no interrupt has to be disabled to read
+ * it. When the ring buffer is full, new samples of its channel are
+ * discarded and counted, see adc_overruns().
+ *
+ * With ADC_OVERSAMPLE n, the interrupt sums 4^n conversions of each
+ * channel in 32 bits and stores the sum shifted right by n, i.e. a
+ * sample with 10 + n bits (ADC_BITS). The extra bits are valid only
+ * when the input has at least 1 LSB of noise, which is the usual case.
+ * Consumers read 4^n times fewer samples, so they are not slowed down.
+ * adc_millivolts() converts samples of any resolution to millivolts.
+ *
+ * adc_init_rate() configures the timer ADC_RATE_TIMER itself. With
+ * adc_init(), the timer of the trigger source is configured by
+ * application. When the timer interrupt is not enabled, the library
+ * clears the trigger flag, which is needed for the next trigger. The
+ * trigger period must be longer than one conversion, i.e. 13.5 ADC
+ * clock cycles (108 us with prescaler 128).
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/io.h>
+
+
+/* Defines -----------------------------------------------------------*/
+/** @brief Maximal number of channels in the list */
+#ifndef ADC_CHANNELS_MAX
+# define ADC_CHANNELS_MAX 4
+#endif
+
+/** @brief Samples per channel ring buffer, power of 2 from 2 to 256.
+ *         One slot stays unused to distinguish full from empty buffer. */
+#ifndef ADC_RING_SIZE
+# define ADC_RING_SIZE 16
+#endif
+
+/** @brief Voltage reference bits of ADMUX, default AVcc with external
+ *         capacitor at AREF pin */
+#ifndef ADC_REFERENCE
+# define ADC_REFERENCE (1<<REFS0)
+#endif
+
+/** @brief ADC clock prescaler bits of ADCSRA, default 128, i.e. 125 kHz
+ *         ADC clock and 9615 conversions/s in free running mode */
+#ifndef ADC_PRESCALER
+# define ADC_PRESCALER ((1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0))
+#endif
+
+/** @brief Timer used by adc_init_rate(): 0 for Timer/Counter0 (trigger
+ *         rate 61 Hz to 9 kHz), 1 for Timer/Counter1 (1 Hz to 9 kHz).
+ *         Add build_flags = -DADC_RATE_TIMER=1 to platformio.ini when
+ *         Timer/Counter0 is used by application. */
+#ifndef ADC_RATE_TIMER
+# define ADC_RATE_TIMER 0
+#endif
+
+/** @brief Oversampling: 4^n conversions are decimated to one sample
+ *         with n extra bits, n from 0 (none) to 4. Add build_flags =
+ *         -DADC_OVERSAMPLE=n to platformio.ini. */
+#ifndef ADC_OVERSAMPLE
+# define ADC_OVERSAMPLE 0
+#endif
+
+#if ADC_OVERSAMPLE < 0 || ADC_OVERSAMPLE > 4
+# error "ADC_OVERSAMPLE must be from 0 to 4"
+#endif
+
+#define ADC_OVERSAMPLE_COUNT (1U << (2 * ADC_OVERSAMPLE)) /**< @brief Conversions per sample, 4^n */
+#define ADC_BITS (10 + ADC_OVERSAMPLE)                    /**< @brief Resolution of samples, 10 to 14 bits */
+
+/* ADC Auto Trigger Sources, values of ADTS bits */
+#define ADC_TRIGGER_FREE       0 /**< @brief Free running, next conversion starts after the previous one */
+#define ADC_TRIGGER_TIM0_COMPA 3 /**< @brief Timer/Counter0 Compare Match A */
+#define ADC_TRIGGER_TIM0_OVF   4 /**< @brief Timer/Counter0 Overflow */
+#define ADC_TRIGGER_TIM1_COMPB 5 /**< @brief Timer/Counter1 Compare Match B */
+#define ADC_TRIGGER_TIM1_OVF   6 /**< @brief Timer/Counter1 Overflow */
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Configure ADC and start sampling of the channel list. Global
+ *         interrupts must be enabled by sei().
+ * @param  channels Channel numbers (MUX bits), e.g. 0 for ADC0
+ * @param  count    Number of channels, 1 to ADC_CHANNELS_MAX
+ * @param  trigger  ADC_TRIGGER_FREE or one of timer trigger sources
+ * @return none
+ */
+void adc_init(const uint8_t *channels, uint8_t count, uint8_t trigger);
+
+
+/**
+ * @brief  Sample the channel list at fixed rate. ADC_RATE_TIMER is set
+ *         to CTC mode and its compare match starts the conversions, no
+ *         timer interrupt is used. Global interrupts must be enabled by
+ *         sei().
+ * @param  channels Channel numbers (MUX bits), e.g. 0 for ADC0
+ * @param  count    Number of channels, 1 to ADC_CHANNELS_MAX
+ * @param  rate     Samples per second of each channel after decimation,
+ *                  the timer runs count * ADC_OVERSAMPLE_COUNT times
+ *                  faster. Rate is rounded to the nearest reachable one
+ *                  and limited to the range of the timer.
+ * @return none
+ */
+void adc_init_rate(const uint8_t *channels, uint8_t count, uint16_t rate);
+
+
+/**
+ * @brief  Get number of samples waiting in ring buffer.
+ * @param  index Position of the channel in the list passed to adc_init()
+ * @return Number of samples
+ */
+uint8_t adc_available(uint8_t index);
+
+
+/**
+ * @brief  Read the oldest sample from ring buffer.
+ * @param  index Position of the channel in the list passed to adc_init()
+ * @param  value Destination of the sample with ADC_BITS resolution
+ * @return 1 if a sample was read, 0 if ring buffer is empty
+ */
+uint8_t adc_get(uint8_t index, uint16_t *value);
+
+
+/**
+ * @brief  Convert sample to voltage in millivolts. Computed in 32 bits
+ *         and rounded, so it never overflows, and without division.
+ * @param  value   Sample with ADC_BITS resolution
+ * @param  vref_mv Voltage reference in millivolts, e.g. 5000 for AVcc
+ * @return Input voltage in millivolts
+ */
+uint16_t adc_millivolts(uint16_t value, uint16_t vref_mv);
+
+
+/**
+ * @brief  Get number of samples discarded due to full ring buffers.
+ *         The counter is cleared by each call.
+ * @return Number of samples discarded since the last call
+ */
+unsigned int adc_overruns(void);
+
+
+/** @} */
+
+#endif
@@ -0,0 +1,109 @@
+/***********************************************************************
+ *
+ * Binary framing of telemetry messages sent by UART.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <frame.h>
+#include <util/crc16.h>     // CRC computations from AVR libc
+#include <uart.h>           // Peter Fleury's UART library
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: frame_crc16()
+ * Purpose:  Update CRC-16/CCITT-FALSE by a block of bytes.
+ * Input(s): crc - Previous CRC value
+ *           data - Data bytes
+ *           len - Number of data bytes
+ * Returns:  Updated CRC value
+ **********************************************************************/
+uint16_t frame_crc16(uint16_t crc, const void *data, uint8_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--)
+        crc = _crc_xmodem_update(crc, *p++);
+    return crc;
+}
+
+
+/**********************************************************************
+ * Function: frame_put()
+ * Purpose:  COBS encode one byte. Zero byte closes the current block,
+ *           i.e. its length is written to the code byte and the zero
+ *           byte becomes code byte of the next block.
+ * Input(s): code - Pointer to code byte of current block
+ *           dst - Pointer to next free position
+ *           byte - Byte to be encoded
+ * Returns:  none
+ **********************************************************************/
+static inline void frame_put(uint8_t **code, uint8_t **dst, uint8_t byte)
+{
+    if (byte == 0)
+    {
+        **code = *dst - *code;
+        *code = (*dst)++;
+    }
+    else
+    {
+        *(*dst)++ = byte;
+    }
+}
+
+
+/**********************************************************************
+ * Function: frame_encode()
+ * Purpose:  Encode a message into a buffer.
+ * Input(s): buf - Buffer of FRAME_ENCODED_SIZE(len) bytes
+ *           type - Message type
+ *           payload - Message data
+ *           len - Number of payload bytes, at most 250
+ * Returns:  Number of encoded bytes including the delimiter
+ **********************************************************************/
+uint8_t frame_encode(uint8_t *buf, uint8_t type, const void *payload, uint8_t len)
+{
+    uint8_t *code = buf;            // Code byte of current COBS block
+    uint8_t *dst = buf + 1;
+    const uint8_t *p = payload;
+    uint16_t crc;
+
+    crc = _crc_xmodem_update(FRAME_CRC_INIT, type);
+    crc = frame_crc16(crc, payload, len);
+
+    // Frame is shorter than 254 bytes, no block has to be split
+    frame_put(&code, &dst, type);
+    while (len--)
+        frame_put(&code, &dst, *p++);
+    frame_put(&code, &dst, crc & 0xff);
+    frame_put(&code, &dst, crc >> 8);
+    *code = dst - code;
+    *dst++ = FRAME_DELIMITER;
+
+    return dst - buf;
+}
+
+
+/**********************************************************************
+ * Function: frame_send()
+ * Purpose:  Encode a message and write the whole frame to UART.
+ * Input(s): type - Message type
+ *           payload - Message data
+ *           len - Number of payload bytes
+ * Returns:  none
+ **********************************************************************/
+void frame_send(uint8_t type, const void *payload, uint8_t len)
+{
+    uint8_t buf[FRAME_ENCODED_SIZE(FRAME_PAYLOAD_MAX)];
+
+    if (len > FRAME_PAYLOAD_MAX)
+        len = FRAME_PAYLOAD_MAX;
+
+    uart_write(buf, frame_encode(buf, type, payload, len));
+}
@@ -0,0 +1,101 @@
+#ifndef FRAME_H
+# define FRAME_H
+
+/***********************************************************************
+ *
+ * Binary framing of telemetry messages sent by UART.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @defgroup frame Binary Telemetry Frames <frame.h>
+ * @code #include <frame.h> @endcode
+ *
+ * @brief COBS encoded frames with type byte and CRC16 on top of the
+ *        UART library.
+ *
+ * Every frame carries one message of the application. Before encoding
+ * it looks as follows, multi-byte values are little endian:
+ * @code
+ * | type | payload (0 to FRAME_PAYLOAD_MAX bytes) | CRC16 low | CRC16 high |
+ * @endcode
+ * CRC16 is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+ * of the type and payload bytes. The frame is encoded by Consistent
+ * Overhead Byte Stuffing (COBS), so it contains no zero byte, and is
+ * terminated by FRAME_DELIMITER. The receiver synchronizes on the
+ * delimiter and drops every frame with a wrong CRC, e.g. a frame
+ * truncated by the UART_TX_DROP policy. Application defines the meaning
+ * of the type and payload bytes.
+ *
+ * Linux decoder of the frames is in tools/frame_decode.c.
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/io.h>
+
+
+/* Defines -----------------------------------------------------------*/
+/** @brief Maximal payload size in bytes, define -DFRAME_PAYLOAD_MAX=nn
+ *         in platformio.ini build_flags to change it */
+#ifndef FRAME_PAYLOAD_MAX
+# define FRAME_PAYLOAD_MAX 32
+#endif
+
+/* Up to 253 bytes before encoding fit into one COBS block */
+#if FRAME_PAYLOAD_MAX < 1 || FRAME_PAYLOAD_MAX > 250
+# error "FRAME_PAYLOAD_MAX must be from 1 to 250"
+#endif
+
+#define FRAME_DELIMITER 0x00   /**< @brief Byte terminating each frame */
+#define FRAME_CRC_INIT  0xFFFF /**< @brief Initial value of CRC16 */
+
+/** @brief Size of encoded frame with payload of n bytes, including
+ *         COBS code byte, type, CRC16 and delimiter */
+#define FRAME_ENCODED_SIZE(n) ((n) + 5)
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Update CRC-16/CCITT-FALSE by a block of bytes.
+ * @param  crc  Previous CRC value, FRAME_CRC_INIT for the first block
+ * @param  data Data bytes
+ * @param  len  Number of data bytes
+ * @return Updated CRC value
+ */
+uint16_t frame_crc16(uint16_t crc, const void *data, uint8_t len);
+
+
+/**
+ * @brief  Encode a message into a buffer, e.g. a ping-pong transmit
+ *         buffer of the UART library.
+ * @param  buf     Buffer of at least FRAME_ENCODED_SIZE(len) bytes
+ * @param  type    Message type defined by application
+ * @param  payload Message data
+ * @param  len     Number of payload bytes, at most 250
+ * @return Number of bytes written to buf, including FRAME_DELIMITER
+ */
+uint8_t frame_encode(uint8_t *buf, uint8_t type, const void *payload, uint8_t len);
+
+
+/**
+ * @brief  Encode a message and write the whole frame to UART transmit
+ *         buffer at once by uart_write().
+ * @param  type    Message type defined by application
+ * @param  payload Message data
+ * @param  len     Number of payload bytes, longer payload is cut to
+ *                 FRAME_PAYLOAD_MAX
+ * @return none
+ */
+void frame_send(uint8_t type, const void *payload, uint8_t len);
+
+
+/** @} */
+
+#endif
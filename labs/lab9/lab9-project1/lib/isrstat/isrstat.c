@@ -0,0 +1,78 @@
+/***********************************************************************
+ *
+ * Execution time and latency statistics of interrupt service routines.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <isrstat.h>
+#include <util/atomic.h>    // Atomically executed code blocks
+
+
+/* Variables ---------------------------------------------------------*/
+isrstat_t isrstat[ISRSTAT_VECTORS];
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: isrstat_init()
+ * Purpose:  Clear statistics and configure the debug pin as output.
+ * Returns:  none
+ **********************************************************************/
+void isrstat_init(void)
+{
+    uint8_t i;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (i = 0; i < ISRSTAT_VECTORS; i++)
+        {
+            isrstat[i].count = 0;
+            isrstat[i].min = 0xffff;
+            isrstat[i].max = 0;
+            isrstat[i].sum = 0;
+            isrstat[i].latency = 0;
+        }
+    }
+
+#if defined(ISRSTAT_DEBUG_PORT) && defined(ISRSTAT_DEBUG_PIN)
+    // Data direction register is just below the port register
+    *(&ISRSTAT_DEBUG_PORT - 1) |= (1<<ISRSTAT_DEBUG_PIN);
+    ISRSTAT_DEBUG_LOW();
+#endif
+}
+
+
+/**********************************************************************
+ * Function: isrstat_get()
+ * Purpose:  Copy statistics of one routine with interrupts disabled.
+ * Input(s): id - Number of the routine
+ *           stat - Destination of the copy
+ * Returns:  none
+ **********************************************************************/
+void isrstat_get(uint8_t id, isrstat_t *stat)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *stat = isrstat[id];
+    }
+}
+
+
+/**********************************************************************
+ * Function: isrstat_avg()
+ * Purpose:  Get average execution time.
+ * Input(s): stat - Statistics of one routine
+ * Returns:  Average execution time in timer ticks, 0 without any run
+ **********************************************************************/
+uint16_t isrstat_avg(const isrstat_t *stat)
+{
+    if (stat->count == 0)
+        return 0;
+    return (stat->sum + stat->count / 2) / stat->count;
+}
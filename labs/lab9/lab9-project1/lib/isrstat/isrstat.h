@@ -0,0 +1,194 @@
+#ifndef ISRSTAT_H
+# define ISRSTAT_H
+
+/***********************************************************************
+ *
+ * Execution time and latency statistics of interrupt service routines.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @defgroup isrstat ISR Statistics Library <isrstat.h>
+ * @code #include <isrstat.h> @endcode
+ *
+ * @brief Opt-in measurement of how long each interrupt service routine
+ *        runs, timestamped by Timer/Counter1.
+ *
+ * Every instrumented routine gets a number from 0 to ISRSTAT_VECTORS-1
+ * and marks its entry and exit:
+ * @code
+ * ISR(TIMER1_OVF_vect)
+ * {
+ *     ISRSTAT_ENTER_AT(0, 0);     // Overflow event is at TCNT1 = 0
+ *     ...
+ *     ISRSTAT_EXIT(0);
+ * }
+ * @endcode
+ *
+ * The macros are empty unless build_flags = -DISRSTAT=1 is added to
+ * platformio.ini, so the instrumentation costs nothing when it is off.
+ * When on, the exit updates count, minimum, maximum and sum of the
+ * execution time. Count and sum stop after 65535 runs, so the average
+ * stays exact, while minimum and maximum keep being updated.
+ * ISRSTAT_ENTER_AT() also stores the maximal latency, i.e. timer ticks
+ * from the event which triggered the interrupt (0 for overflow, OCR1A
+ * for compare match) to the entry.
+ *
+ * The unit is one tick of Timer/Counter1, e.g. 0.5 us with prescaler 8,
+ * and the timer must run. Durations are computed modulo 2^16, so they
+ * are correct in normal mode, or in other modes when shorter than one
+ * period. The prologue of the routine before ISRSTAT_ENTER() and the
+ * epilogue after ISRSTAT_EXIT() are not included.
+ *
+ * The ADC and UART libraries instrument their own routines with the
+ * numbers ISRSTAT_ADC, ISRSTAT_UART_RX and ISRSTAT_UART_UDRE, number 0 is
+ * left for the application.
+ *
+ * With ISRSTAT_DEBUG_PORT and ISRSTAT_DEBUG_PIN defined, e.g.
+ * -DISRSTAT_DEBUG_PORT=PORTB -DISRSTAT_DEBUG_PIN=0, the pin is high
+ * while an instrumented routine runs, which shows latency and jitter on
+ * an oscilloscope as well.
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/io.h>
+
+
+/* Defines -----------------------------------------------------------*/
+/** @brief 1 enables the instrumentation, 0 makes all macros empty */
+#ifndef ISRSTAT
+# define ISRSTAT 0
+#endif
+
+/** @brief Number of instrumented routines */
+#ifndef ISRSTAT_VECTORS
+# define ISRSTAT_VECTORS 4
+#endif
+
+/** @brief Numbers of routines instrumented by the libraries */
+#define ISRSTAT_ADC       1 /**< @brief ADC_vect of the adc library */
+#define ISRSTAT_UART_RX   2 /**< @brief Receive interrupt of the uart library */
+#define ISRSTAT_UART_UDRE 3 /**< @brief Transmit interrupt of the uart library */
+
+/** @brief Free running timer used for timestamps */
+#ifndef ISRSTAT_TIMER
+# define ISRSTAT_TIMER TCNT1
+#endif
+
+#if defined(ISRSTAT_DEBUG_PORT) && defined(ISRSTAT_DEBUG_PIN)
+# define ISRSTAT_DEBUG_HIGH() ISRSTAT_DEBUG_PORT |= (1<<ISRSTAT_DEBUG_PIN)
+# define ISRSTAT_DEBUG_LOW()  ISRSTAT_DEBUG_PORT &= ~(1<<ISRSTAT_DEBUG_PIN)
+#else
+# define ISRSTAT_DEBUG_HIGH()
+# define ISRSTAT_DEBUG_LOW()
+#endif
+
+#if ISRSTAT
+/** @brief Mark entry of routine id, must be the first statement */
+# define ISRSTAT_ENTER(id)                                  \
+    uint16_t isrstat_entry = ISRSTAT_TIMER;                 \
+    ISRSTAT_DEBUG_HIGH()
+
+/** @brief Mark entry of routine id triggered at timer value event */
+# define ISRSTAT_ENTER_AT(id, event)                        \
+    ISRSTAT_ENTER(id);                                      \
+    isrstat_latency((id), isrstat_entry - (uint16_t) (event))
+
+/** @brief Mark exit of routine id */
+# define ISRSTAT_EXIT(id)                                   \
+    isrstat_exit((id), ISRSTAT_TIMER - isrstat_entry);      \
+    ISRSTAT_DEBUG_LOW()
+#else
+# define ISRSTAT_ENTER(id)
+# define ISRSTAT_ENTER_AT(id, event)
+# define ISRSTAT_EXIT(id)
+#endif
+
+
+/* Types -------------------------------------------------------------*/
+/** @brief Statistics of one routine, times in timer ticks */
+typedef struct
+{
+    uint16_t count;         /**< @brief Number of runs, stops at 65535 */
+    uint16_t min;           /**< @brief Shortest execution time */
+    uint16_t max;           /**< @brief Longest execution time */
+    uint32_t sum;           /**< @brief Sum of execution times, stops with count */
+    uint16_t latency;       /**< @brief Longest latency, see ISRSTAT_ENTER_AT() */
+} isrstat_t;
+
+
+/* Variables ---------------------------------------------------------*/
+extern isrstat_t isrstat[ISRSTAT_VECTORS];
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Clear statistics and configure the debug pin as output.
+ * @return none
+ */
+void isrstat_init(void);
+
+
+/**
+ * @brief  Copy statistics of one routine, consistent even when the
+ *         routine runs meanwhile.
+ * @param  id   Number of the routine
+ * @param  stat Destination of the copy
+ * @return none
+ */
+void isrstat_get(uint8_t id, isrstat_t *stat);
+
+
+/**
+ * @brief  Get average execution time.
+ * @param  stat Statistics of one routine
+ * @return Average execution time in timer ticks, 0 without any run
+ */
+uint16_t isrstat_avg(const isrstat_t *stat);
+
+
+/**
+ * @brief  Update statistics by one run, called by ISRSTAT_EXIT().
+ * @param  id    Number of the routine
+ * @param  ticks Execution time
+ * @return none
+ */
+static inline void isrstat_exit(uint8_t id, uint16_t ticks)
+{
+    isrstat_t *s = &isrstat[id];
+
+    if (s->count != 0xffff)
+    {
+        s->count++;
+        s->sum += ticks;
+    }
+    if (ticks < s->min)
+        s->min = ticks;
+    if (ticks > s->max)
+        s->max = ticks;
+}
+
+
+/**
+ * @brief  Update maximal latency, called by ISRSTAT_ENTER_AT().
+ * @param  id    Number of the routine
+ * @param  ticks Latency
+ * @return none
+ */
+static inline void isrstat_latency(uint8_t id, uint16_t ticks)
+{
+    if (ticks > isrstat[id].latency)
+        isrstat[id].latency = ticks;
+}
+
+
+/** @} */
+
+#endif
@@ -110,6 +110,9 @@
  * is possible to connect these data lines in different order or even on different
  * ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
  *
+ * If the RW line is connected to the MCU, set LCD_RW_WIRED to 1. Every write
+ * then waits for the busy flag instead of the worst-case LCD_DELAY_WRITE.
+ *
  * Adjust these definitions to your target.\n
  * These definitions can be defined in a separate include file \b lcd_definitions.h instead modifying this file by
  * adding \b -D_LCD_DEFINITIONS_FILE to the \b CDEFS section in the Makefile.
@@ -182,6 +185,10 @@
 
 #endif // if LCD_IO_MODE
 
+#ifndef LCD_RW_WIRED
+# define LCD_RW_WIRED 0 /**< 0: RW tied to GND, fixed delays, 1: RW connected, busy flag polled */
+#endif
+
 
 /**
  * @name Definitions of delays
@@ -211,6 +218,37 @@
 #ifndef LCD_DELAY_ENABLE_PULSE
 # define LCD_DELAY_ENABLE_PULSE 1 /**< enable signal pulse width in micro seconds */
 #endif
+#ifndef LCD_DELAY_WRITE
+# define LCD_DELAY_WRITE 800 /**< delay in micro seconds after each byte written, see lcd_write() */
+#endif
+#ifndef LCD_DELAY_CLEAR
+# define LCD_DELAY_CLEAR 1600 /**< execution time in micro seconds of clear display and return home */
+#endif
+
+
+/**
+ * @name Definitions for interrupt driven output
+ * With LCD_ASYNC set to 1, lcd_command() and lcd_data() only store the byte
+ * in a ring buffer and return. Timer/Counter2 in CTC mode drains the buffer
+ * from its compare match A interrupt, one nibble per interrupt, and waits
+ * for the previous instruction by reloading OCR2A with its execution time.
+ * When the buffer is full the caller waits for a free slot, also with
+ * interrupts disabled (e.g. inside another ISR).
+ *
+ * lcd_init() writes the power-on sequence blocking, but returns with the
+ * commands that follow the switch to 4-bit mode still queued; they reach
+ * the display only once interrupts are enabled. Timer/Counter2 is reserved
+ * for the LCD and lcd_getxy() must not be used in this mode. The interrupt writes the data
+ * nibble by one read-modify-write of the port when the data pins are
+ * consecutive, so other pins of that port must be changed atomically, e.g.
+ * PORTB |= _BV(PB5) or with interrupts disabled.
+ */
+#ifndef LCD_ASYNC
+# define LCD_ASYNC 0 /**< 0: blocking writes, 1: interrupt driven write queue */
+#endif
+#ifndef LCD_QUEUE_SIZE
+# define LCD_QUEUE_SIZE 32 /**< size of the write queue in bytes, must be a power of 2 from 2 to 256 */
+#endif
 
 
 /**
@@ -281,6 +319,8 @@
  *                  \b LCD_DISP_ON_CURSOR display on, cursor on\n
  *                  \b LCD_DISP_ON_CURSOR_BLINK display on, cursor on flashing
  * @return  none
+ * @note     With LCD_ASYNC the function returns before the display is
+ *           configured, see Definitions for interrupt driven output
  */
 extern void lcd_init(uint8_t dispAttr);
 
@@ -74,6 +74,15 @@
 // R/W pin is connected to GND on LCD Keypad Shield
 
 
+/**
+ * @name Definitions for interrupt driven output
+ * LCD writes are only queued and Timer/Counter2 compare interrupt sends
+ * them to the display, so ADC and Timer/Counter1 interrupts do not wait
+ * for the slow LCD Keypad Shield.
+ */
+#define LCD_ASYNC       1   /**< @brief Queue LCD writes, drained by Timer/Counter2 */
+
+
 /** @} */
 
 #endif
\ No newline at end of file
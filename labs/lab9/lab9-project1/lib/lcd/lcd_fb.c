@@ -0,0 +1,123 @@
+/***********************************************************************
+ * 
+ * Frame buffer layer for Peter Fleury's HD44780U LCD library.
+ * 
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <lcd_fb.h>
+
+
+/* Variables ---------------------------------------------------------*/
+char lcd_fb[LCD_LINES][LCD_DISP_LENGTH];
+static char lcd_fb_shown[LCD_LINES][LCD_DISP_LENGTH];  // Content of the display
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: lcd_fb_init()
+ * Purpose:  Clear display and frame buffer.
+ * Returns:  none
+ **********************************************************************/
+void lcd_fb_init(void)
+{
+    uint8_t x, y;
+
+    lcd_clrscr();
+    for (y = 0; y < LCD_LINES; y++)
+    {
+        for (x = 0; x < LCD_DISP_LENGTH; x++)
+        {
+            lcd_fb[y][x] = ' ';
+            lcd_fb_shown[y][x] = ' ';
+        }
+    }
+}
+
+
+/**********************************************************************
+ * Function: lcd_fb_clear()
+ * Purpose:  Fill frame buffer with spaces.
+ * Returns:  none
+ **********************************************************************/
+void lcd_fb_clear(void)
+{
+    uint8_t x, y;
+
+    for (y = 0; y < LCD_LINES; y++)
+        for (x = 0; x < LCD_DISP_LENGTH; x++)
+            lcd_fb[y][x] = ' ';
+}
+
+
+/**********************************************************************
+ * Function: lcd_fb_putc()
+ * Purpose:  Write one character to frame buffer.
+ * Input(s): x, y - Position of the character
+ *           c - Character to be displayed
+ * Returns:  none
+ **********************************************************************/
+void lcd_fb_putc(uint8_t x, uint8_t y, char c)
+{
+    if ((x < LCD_DISP_LENGTH) && (y < LCD_LINES))
+        lcd_fb[y][x] = c;
+}
+
+
+/**********************************************************************
+ * Function: lcd_fb_puts()
+ * Purpose:  Write string to frame buffer without line wrapping.
+ * Input(s): x, y - Position of the first character
+ *           s - String to be displayed
+ * Returns:  Horizontal position behind the last written character
+ **********************************************************************/
+uint8_t lcd_fb_puts(uint8_t x, uint8_t y, const char *s)
+{
+    if (y >= LCD_LINES)
+        return x;
+
+    while (*s && (x < LCD_DISP_LENGTH))
+        lcd_fb[y][x++] = *s++;
+
+    return x;
+}
+
+
+/**********************************************************************
+ * Function: lcd_fb_flush()
+ * Purpose:  Send changed cells of frame buffer to the display. Cursor
+ *           position is set only at the beginning of each run of
+ *           changed cells, the display increments it automatically.
+ * Returns:  Number of characters sent to the display
+ **********************************************************************/
+uint8_t lcd_fb_flush(void)
+{
+    uint8_t x, y;
+    uint8_t cursor;     // Column of display cursor, LCD_DISP_LENGTH if unknown
+    uint8_t sent = 0;
+    char c;
+
+    for (y = 0; y < LCD_LINES; y++)
+    {
+        cursor = LCD_DISP_LENGTH;
+        for (x = 0; x < LCD_DISP_LENGTH; x++)
+        {
+            c = lcd_fb[y][x];
+            if (c != lcd_fb_shown[y][x])
+            {
+                if (cursor != x)
+                    lcd_gotoxy(x, y);
+                lcd_data(c);
+                lcd_fb_shown[y][x] = c;
+                cursor = x + 1;
+                sent++;
+            }
+        }
+    }
+    return sent;
+}
@@ -0,0 +1,182 @@
+#ifndef RING_H
+# define RING_H
+
+/***********************************************************************
+ *
+ * Lock-free single-producer single-consumer ring buffer.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @defgroup ring Ring Buffer <ring.h>
+ * @code #include <ring.h> @endcode
+ *
+ * @brief Header-only ring buffer shared by interrupt driven libraries.
+ *
+ * RING_DEFINE(name, type, size) works as a template. It defines the
+ * structure name_t and inline functions name_push(), name_pop(),
+ * name_write(), name_read() etc. for elements of the given type:
+ * @code
+ * RING_DEFINE(rx_ring, uint8_t, 64)
+ * static rx_ring_t rx;
+ *
+ * ISR(USART_RX_vect)
+ * {
+ *     rx_ring_push(&rx, UDR0);            // Producer
+ * }
+ *
+ * uint8_t c;
+ * if (rx_ring_pop(&rx, &c))               // Consumer
+ * {
+ *     ...
+ * }
+ * @endcode
+ *
+ * The producer writes only head and the consumer writes only tail,
+ * both are single bytes. With exactly one producer and one consumer,
+ * e.g. an interrupt and the main loop, no interrupt has to be disabled.
+ * Element is stored before head is published and read before tail is
+ * released, a compiler barrier keeps this order. Bulk functions copy
+ * a block and publish the index once.
+ *
+ * Size is a power of 2 from 2 to 256, checked at compile time. One
+ * slot stays unused to distinguish full from empty buffer. The
+ * structure is zero initialized as a global variable, otherwise call
+ * name_init().
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Defines -----------------------------------------------------------*/
+/** @brief Compiler memory barrier, memory accesses are not moved across */
+#define RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/**
+ * @brief Define ring buffer type name_t and its functions.
+ * @param name Prefix of the type and function names
+ * @param type Element type
+ * @param size Number of elements, power of 2 from 2 to 256
+ */
+#define RING_DEFINE(name, type, size)                                       \
+                                                                            \
+typedef char name##_size_check[((size) >= 2 && (size) <= 256 &&             \
+                                 ((size) & ((size) - 1)) == 0) ? 1 : -1];   \
+                                                                            \
+typedef struct                                                              \
+{                                                                           \
+    type buf[size];                                                         \
+    volatile uint8_t head;  /* next slot to write, producer only */         \
+    volatile uint8_t tail;  /* next slot to read, consumer only  */         \
+} name##_t;                                                                 \
+                                                                            \
+/* Empty the buffer, neither producer nor consumer may run */               \
+static inline void name##_init(name##_t *r)                                 \
+{                                                                           \
+    r->head = 0;                                                            \
+    r->tail = 0;                                                            \
+}                                                                           \
+                                                                            \
+/* Number of stored elements */                                             \
+static inline uint8_t name##_count(const name##_t *r)                       \
+{                                                                           \
+    return (uint8_t) (r->head - r->tail) & ((size) - 1);                    \
+}                                                                           \
+                                                                            \
+/* Number of free slots */                                                  \
+static inline uint8_t name##_space(const name##_t *r)                       \
+{                                                                           \
+    return (uint8_t) (r->tail - r->head - 1) & ((size) - 1);                \
+}                                                                           \
+                                                                            \
+/* Producer: store one element, return 0 when buffer is full */             \
+static inline uint8_t name##_push(name##_t *r, type value)                  \
+{                                                                           \
+    uint8_t head = r->head;                                                 \
+    uint8_t next = (uint8_t) (head + 1) & ((size) - 1);                     \
+                                                                            \
+    if (next == r->tail)                                                    \
+        return 0;                                                           \
+    r->buf[head] = value;                                                   \
+    RING_BARRIER();                                                         \
+    r->head = next;                                                         \
+    return 1;                                                               \
+}                                                                           \
+                                                                            \
+/* Consumer: read the oldest element, return 0 when buffer is empty */      \
+static inline uint8_t name##_pop(name##_t *r, type *value)                  \
+{                                                                           \
+    uint8_t tail = r->tail;                                                 \
+                                                                            \
+    if (tail == r->head)                                                    \
+        return 0;                                                           \
+    RING_BARRIER();                                                         \
+    *value = r->buf[tail];                                                  \
+    RING_BARRIER();                                                         \
+    r->tail = (uint8_t) (tail + 1) & ((size) - 1);                          \
+    return 1;                                                               \
+}                                                                           \
+                                                                            \
+/* Consumer: discard the oldest element, return 0 when buffer is empty */   \
+static inline uint8_t name##_drop(name##_t *r)                              \
+{                                                                           \
+    uint8_t tail = r->tail;                                                 \
+                                                                            \
+    if (tail == r->head)                                                    \
+        return 0;                                                           \
+    r->tail = (uint8_t) (tail + 1) & ((size) - 1);                          \
+    return 1;                                                               \
+}                                                                           \
+                                                                            \
+/* Producer: store as many elements as fit, return number stored */        \
+static inline uint8_t name##_write(name##_t *r, const type *src,            \
+                                   uint8_t len)                             \
+{                                                                           \
+    uint8_t head = r->head;                                                 \
+    uint8_t space = name##_space(r);                                        \
+    uint8_t n;                                                              \
+                                                                            \
+    if (len > space)                                                        \
+        len = space;                                                        \
+    for (n = len; n; n--)                                                   \
+    {                                                                       \
+        r->buf[head] = *src++;                                              \
+        head = (uint8_t) (head + 1) & ((size) - 1);                         \
+    }                                                                       \
+    RING_BARRIER();                                                         \
+    r->head = head;                                                         \
+    return len;                                                             \
+}                                                                           \
+                                                                            \
+/* Consumer: read up to len oldest elements, return number read */         \
+static inline uint8_t name##_read(name##_t *r, type *dst, uint8_t len)      \
+{                                                                           \
+    uint8_t tail = r->tail;                                                 \
+    uint8_t count = name##_count(r);                                        \
+    uint8_t n;                                                              \
+                                                                            \
+    if (len > count)                                                        \
+        len = count;                                                        \
+    RING_BARRIER();                                                         \
+    for (n = len; n; n--)                                                   \
+    {                                                                       \
+        *dst++ = r->buf[tail];                                              \
+        tail = (uint8_t) (tail + 1) & ((size) - 1);                         \
+    }                                                                       \
+    RING_BARRIER();                                                         \
+    r->tail = tail;                                                         \
+    return len;                                                             \
+}
+
+
+/** @} */
+
+#endif
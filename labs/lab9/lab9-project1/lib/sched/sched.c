@@ -0,0 +1,176 @@
+/***********************************************************************
+ *
+ * Cooperative run-to-completion event scheduler.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <stddef.h>
+#include <util/atomic.h>    // Atomically executed code blocks
+#include <ring.h>           // Lock-free ring buffer
+#include <sched.h>
+
+
+/* Types -------------------------------------------------------------*/
+// Queue of event values sched_queue_t
+RING_DEFINE(sched_queue, uint16_t, SCHED_QUEUE_SIZE)
+
+
+/* Variables ---------------------------------------------------------*/
+static volatile uint8_t sched_pending;          // Events posted by sched_post()
+static volatile uint8_t sched_queued;           // Events posted by sched_post_data()
+static sched_handler_t sched_handlers[SCHED_EVENTS];
+static sched_queue_t sched_queues[SCHED_EVENTS];
+static volatile unsigned int sched_overrun;
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: sched_init()
+ * Purpose:  Clear all events and handlers.
+ * Returns:  none
+ **********************************************************************/
+void sched_init(void)
+{
+    uint8_t i;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sched_pending = 0;
+        sched_queued = 0;
+        sched_overrun = 0;
+        for (i = 0; i < SCHED_EVENTS; i++)
+        {
+            sched_handlers[i] = NULL;
+            sched_queue_init(&sched_queues[i]);
+        }
+    }
+}
+
+
+/**********************************************************************
+ * Function: sched_handler()
+ * Purpose:  Set handler of the event.
+ * Input(s): event - Event number
+ *           handler - Function called by sched_run()
+ * Returns:  none
+ **********************************************************************/
+void sched_handler(uint8_t event, sched_handler_t handler)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sched_handlers[event] = handler;
+    }
+}
+
+
+/**********************************************************************
+ * Function: sched_post()
+ * Purpose:  Mark event as pending.
+ * Input(s): event - Event number
+ * Returns:  none
+ **********************************************************************/
+void sched_post(uint8_t event)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sched_pending |= (1 << event);
+    }
+}
+
+
+/**********************************************************************
+ * Function: sched_post_data()
+ * Purpose:  Store value to the queue of the event.
+ * Input(s): event - Event number
+ *           value - Value passed to the handler
+ * Returns:  1 if value was stored, 0 if queue is full
+ **********************************************************************/
+uint8_t sched_post_data(uint8_t event, uint16_t value)
+{
+    uint8_t stored = sched_queue_push(&sched_queues[event], value);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (stored)
+            sched_queued |= (1 << event);
+        else
+            sched_overrun++;
+    }
+    return stored;
+}
+
+
+/**********************************************************************
+ * Function: sched_run()
+ * Purpose:  Call handlers of all pending events, lowest number first.
+ *           Queues are drained until empty, so values posted while
+ *           their handler runs are handled too. The queued bit of such
+ *           value may stay set for the next call, when the queue is
+ *           already empty and nothing is called.
+ * Returns:  Number of handler calls
+ **********************************************************************/
+uint8_t sched_run(void)
+{
+    uint8_t pending;
+    uint8_t queued;
+    uint8_t event;
+    uint8_t mask;
+    uint8_t calls = 0;
+    uint16_t value;
+    sched_handler_t handler;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pending = sched_pending;
+        queued = sched_queued;
+        sched_pending = 0;
+        sched_queued = 0;
+    }
+
+    for (event = 0, mask = 1; event < SCHED_EVENTS; event++, mask <<= 1)
+    {
+        handler = sched_handlers[event];
+
+        if (queued & mask)
+        {
+            while (sched_queue_pop(&sched_queues[event], &value))
+            {
+                if (handler)
+                {
+                    handler(value);
+                    calls++;
+                }
+            }
+        }
+        if ((pending & mask) && handler)
+        {
+            handler(0);
+            calls++;
+        }
+    }
+    return calls;
+}
+
+
+/**********************************************************************
+ * Function: sched_overruns()
+ * Purpose:  Get and clear number of discarded values.
+ * Returns:  Number of values discarded since the last call
+ **********************************************************************/
+unsigned int sched_overruns(void)
+{
+    unsigned int overruns;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        overruns = sched_overrun;
+        sched_overrun = 0;
+    }
+    return overruns;
+}
@@ -0,0 +1,137 @@
+#ifndef SCHED_H
+# define SCHED_H
+
+/***********************************************************************
+ *
+ * Cooperative run-to-completion event scheduler.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @defgroup sched Event Scheduler <sched.h>
+ * @code #include <sched.h> @endcode
+ *
+ * @brief Events posted by interrupts and handled by the main loop.
+ *
+ * Interrupt service routines only capture data and post an event, the
+ * slow work (LCD, UART, computations) runs in a handler called from the
+ * main loop, so no interrupt is blocked by it:
+ * @code
+ * #define EV_TICK 0
+ *
+ * void tick_handler(uint16_t value)
+ * {
+ *     lcd_putc(value);                // Slow work with interrupts enabled
+ * }
+ *
+ * ISR(TIMER1_OVF_vect)
+ * {
+ *     sched_post_data(EV_TICK, PINB); // Capture data only
+ * }
+ *
+ * sched_handler(EV_TICK, tick_handler);
+ * sei();
+ * while (1)
+ * {
+ *     sched_run();
+ * }
+ * @endcode
+ *
+ * An event is either a flag or a queue. sched_post() sets the pending
+ * bit of the event, posting it again before it is handled has no
+ * effect, and the handler is called once with value 0. sched_post_data()
+ * stores the value to the queue of the event, and the handler is called
+ * once for each value. Each queue has one producer, e.g. one interrupt.
+ *
+ * sched_run() calls the handlers of all pending events, event 0 first.
+ * Handlers run to completion with interrupts enabled and may post
+ * events themselves, which are handled by the next sched_run().
+ * @{
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Defines -----------------------------------------------------------*/
+/** @brief Number of events, 1 to 8 */
+#ifndef SCHED_EVENTS
+# define SCHED_EVENTS 4
+#endif
+
+/** @brief Values per event queue, power of 2 from 2 to 256. One slot
+ *         stays unused to distinguish full from empty queue. */
+#ifndef SCHED_QUEUE_SIZE
+# define SCHED_QUEUE_SIZE 8
+#endif
+
+#if SCHED_EVENTS < 1 || SCHED_EVENTS > 8
+# error "SCHED_EVENTS must be from 1 to 8"
+#endif
+
+
+/* Types -------------------------------------------------------------*/
+/** @brief Event handler, value is 0 for events without data */
+typedef void (*sched_handler_t)(uint16_t value);
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  Clear all events and handlers.
+ * @return none
+ */
+void sched_init(void);
+
+
+/**
+ * @brief  Set handler of the event.
+ * @param  event   Event number, 0 to SCHED_EVENTS-1
+ * @param  handler Function called by sched_run(), NULL to ignore event
+ * @return none
+ */
+void sched_handler(uint8_t event, sched_handler_t handler);
+
+
+/**
+ * @brief  Mark event as pending, callable from interrupts.
+ * @param  event Event number, 0 to SCHED_EVENTS-1
+ * @return none
+ */
+void sched_post(uint8_t event);
+
+
+/**
+ * @brief  Store value to the queue of the event, callable from
+ *         interrupts. Value is discarded and counted when the queue is
+ *         full, see sched_overruns().
+ * @param  event Event number, 0 to SCHED_EVENTS-1
+ * @param  value Value passed to the handler
+ * @return 1 if value was stored, 0 if queue is full
+ */
+uint8_t sched_post_data(uint8_t event, uint16_t value);
+
+
+/**
+ * @brief  Call handlers of all pending events, lowest event number
+ *         first. Called from the main loop only.
+ * @return Number of handler calls
+ */
+uint8_t sched_run(void);
+
+
+/**
+ * @brief  Get and clear number of values discarded due to full queues.
+ * @return Number of values discarded since the last call
+ */
+unsigned int sched_overruns(void);
+
+
+/** @} */
+
+#endif
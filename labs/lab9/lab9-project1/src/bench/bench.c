@@ -0,0 +1,383 @@
+/***********************************************************************
+ *
+ * Cycle counts of library hot paths, built by [env:bench] in
+ * platformio.ini instead of src/main.c.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * Every hot path is run BENCH_RUNS times with interrupts disabled and
+ * timed by Timer/Counter1 without prescaler, i.e. in CPU cycles. The
+ * cost of reading the timer is subtracted. Interrupt handlers of the
+ * libraries are called as functions, which measures their prologue
+ * and epilogue too. Results are sent once over UART as JSON, one entry
+ * per line, then the CPU sleeps with interrupts disabled. simavr stops
+ * at that point, so tools/bench.sh runs the firmware in simavr and
+ * stores the report. The same firmware runs on the board as well.
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/io.h>         // AVR device-specific IO definitions
+#include <avr/interrupt.h>  // Interrupts standard C library for AVR-GCC
+#include <avr/sleep.h>      // Power management and sleep modes
+#include <stdlib.h>         // C library. Needed for number conversions
+#include <string.h>         // C library for string handling
+#include <gpio.h>           // GPIO library for AVR-GCC
+#include <lcd.h>            // Peter Fleury's LCD library
+#include <uart.h>           // Peter Fleury's UART library
+#include <frame.h>          // Binary telemetry frames over UART
+#include <adc.h>            // Auto-triggered ADC sampling
+#ifndef F_CPU
+# define F_CPU 16000000
+#endif
+#include <util/delay.h>     // Functions for busy-wait delay loops
+
+
+/* Defines -----------------------------------------------------------*/
+#define BENCH_RUNS 16       // Measurements of each hot path
+#define BENCH_MAX  16       // Maximal number of hot paths
+
+// Compiler barrier, statement is not moved across timer reads
+#define BENCH_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/**
+ * Time statement BENCH_RUNS times, setup runs before each measurement
+ * and is not timed. One measurement must be shorter than 65536 cycles.
+ * Interrupts are disabled again after each measurement, because reti
+ * of a called interrupt handler sets the I flag.
+ */
+#define BENCH(name, setup, stmt)                        \
+    do {                                                \
+        uint8_t run;                                    \
+        uint16_t start;                                 \
+        uint16_t stop;                                  \
+        bench_t *b = bench_start(name);                 \
+                                                        \
+        for (run = 0; run < BENCH_RUNS; run++)          \
+        {                                               \
+            setup;                                      \
+            start = TCNT1;                              \
+            BENCH_BARRIER();                            \
+            stmt;                                       \
+            BENCH_BARRIER();                            \
+            stop = TCNT1;                               \
+            cli();                                      \
+            bench_add(b, stop - start);                 \
+        }                                               \
+    } while (0)
+
+
+/* Types -------------------------------------------------------------*/
+typedef struct
+{
+    const char *name;
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+} bench_t;
+
+
+/* Variables ---------------------------------------------------------*/
+static bench_t bench[BENCH_MAX];
+static bench_t bench_dropped;                   // Hot paths beyond BENCH_MAX
+static uint8_t bench_count;
+static uint16_t bench_overhead;                 // Cycles of the timer reads
+
+static volatile uint8_t sink;                   // Results kept by compiler
+static const uint8_t bench_data[16] = "0123456789abcdef";
+static const uint8_t bench_channel = 0;         // ADC0
+
+
+/* Function prototypes -----------------------------------------------*/
+/**
+ * @brief  LFSR-based 4-bit pseudo-random generator with Fibonacci
+ *         architecture, see lab8.
+ * @param  value Current value of LFSR
+ * @return New value of LFSR
+ * @note   Function programmed in AVR assembly language.
+ */
+uint8_t lfsr4_fibonacci_asm(uint8_t value);
+
+// Interrupt handlers of the libraries, called directly to time them
+void USART_UDRE_vect(void);
+void ADC_vect(void);
+#if LCD_ASYNC
+void TIMER2_COMPA_vect(void);
+#endif
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: bench_start()
+ * Purpose:  Add next hot path to the results. Hot paths beyond
+ *           BENCH_MAX are measured, but not reported.
+ * Input(s): name - Key of the hot path in the report
+ * Returns:  Pointer to its results
+ **********************************************************************/
+static bench_t *bench_start(const char *name)
+{
+    bench_t *b = &bench_dropped;
+
+    if (bench_count < BENCH_MAX)
+        b = &bench[bench_count++];
+    b->name = name;
+    b->min = 0xffff;
+    b->max = 0;
+    b->sum = 0;
+    return b;
+}
+
+
+/**********************************************************************
+ * Function: bench_add()
+ * Purpose:  Store one measurement.
+ * Input(s): b - Results of the hot path
+ *           cycles - Measured cycles including the timer reads
+ * Returns:  none
+ **********************************************************************/
+static void bench_add(bench_t *b, uint16_t cycles)
+{
+    cycles -= bench_overhead;
+    if (cycles < b->min)
+        b->min = cycles;
+    if (cycles > b->max)
+        b->max = cycles;
+    b->sum += cycles;
+}
+
+
+/**********************************************************************
+ * Function: bench_calibrate()
+ * Purpose:  Measure cost of the timer reads, which is subtracted from
+ *           all results.
+ * Returns:  none
+ **********************************************************************/
+static void bench_calibrate(void)
+{
+    uint8_t run;
+    uint16_t start;
+    uint16_t stop;
+
+    bench_overhead = 0xffff;
+    for (run = 0; run < BENCH_RUNS; run++)
+    {
+        start = TCNT1;
+        BENCH_BARRIER();
+        BENCH_BARRIER();
+        stop = TCNT1;
+        if ((uint16_t) (stop - start) < bench_overhead)
+            bench_overhead = stop - start;
+    }
+}
+
+
+/**********************************************************************
+ * Function: uart_reset()
+ * Purpose:  Empty UART buffers without sending their content, so
+ *           every measurement starts with the same state.
+ * Returns:  none
+ **********************************************************************/
+static void uart_reset(void)
+{
+    uart_init(UART_BAUD_AUTO);
+}
+
+
+/**********************************************************************
+ * Function: uart_one_space()
+ * Purpose:  Queue one space for the UDRE handler and keep the
+ *           interrupt itself disabled. Spaces are valid whitespace in
+ *           front of the JSON report.
+ * Returns:  none
+ **********************************************************************/
+static void uart_one_space(void)
+{
+    uart_reset();
+    uart_putc(' ');
+    UCSR0B &= ~(1<<UDRIE0);
+    loop_until_bit_is_set(UCSR0A, UDRE0);
+}
+
+
+/**********************************************************************
+ * Function: adc_empty()
+ * Purpose:  Read all samples of ADC0, so the handler never overruns.
+ * Returns:  none
+ **********************************************************************/
+static void adc_empty(void)
+{
+    uint16_t value;
+
+    while (adc_get(0, &value))
+        ;
+}
+
+
+/**********************************************************************
+ * Function: lcd_drain()
+ * Purpose:  Wait until the LCD write queue is empty and its interrupt
+ *           disabled (LCD_ASYNC only). Timer/Counter2 interrupt then
+ *           cannot run inside a measurement after reti of a called
+ *           handler, and every LCD measurement starts with an empty
+ *           queue instead of waiting for a free slot. The interrupt is
+ *           enabled first, lcd_one_entry() leaves a nibble behind.
+ * Returns:  none
+ **********************************************************************/
+static void lcd_drain(void)
+{
+#if LCD_ASYNC
+    TIMSK2 |= _BV(OCIE2A);
+    sei();
+    loop_until_bit_is_clear(TIMSK2, OCIE2A);
+    cli();
+#endif
+}
+
+
+#if LCD_ASYNC
+/**********************************************************************
+ * Function: lcd_one_entry()
+ * Purpose:  Queue one character for the Timer/Counter2 handler and
+ *           keep the interrupt itself disabled.
+ * Returns:  none
+ **********************************************************************/
+static void lcd_one_entry(void)
+{
+    lcd_drain();
+    lcd_putc('x');
+    TIMSK2 &= ~_BV(OCIE2A);
+}
+#endif
+
+
+/**********************************************************************
+ * Function: report_puts()
+ * Purpose:  Send string and wait for free space in buffer. Unlike
+ *           uart_puts(), nothing is dropped with UART_TX_DROP policy.
+ * Input(s): s - String to be transmitted
+ * Returns:  none
+ **********************************************************************/
+static void report_puts(const char *s)
+{
+    unsigned int len = strlen(s);
+    unsigned int n;
+
+    while (len)
+    {
+        n = uart_write_nb(s, len);
+        s += n;
+        len -= n;
+    }
+}
+
+
+/**********************************************************************
+ * Function: report_number()
+ * Purpose:  Send one JSON member with unsigned value.
+ * Input(s): key - Member name
+ *           value - Member value
+ * Returns:  none
+ **********************************************************************/
+static void report_number(const char *key, uint32_t value)
+{
+    char string[11];            // String for converting numbers by ultoa()
+
+    report_puts("\"");
+    report_puts(key);
+    report_puts("\": ");
+    ultoa(value, string, 10);
+    report_puts(string);
+}
+
+
+/**********************************************************************
+ * Function: report()
+ * Purpose:  Send all results as JSON, lines are shorter than 80
+ *           characters.
+ * Returns:  none
+ **********************************************************************/
+static void report(void)
+{
+    uint8_t i;
+
+    report_puts("{\r\n  ");
+    report_number("f_cpu", F_CPU);
+    report_puts(",\r\n  ");
+    report_number("runs", BENCH_RUNS);
+    report_puts(",\r\n  ");
+    report_number("overhead", bench_overhead);
+    report_puts(",\r\n  \"cycles\": {");
+    for (i = 0; i < bench_count; i++)
+    {
+        report_puts(i ? ",\r\n    \"" : "\r\n    \"");
+        report_puts(bench[i].name);
+        report_puts("\": {");
+        report_number("min", bench[i].min);
+        report_puts(", ");
+        report_number("avg", (bench[i].sum + BENCH_RUNS / 2) / BENCH_RUNS);
+        report_puts(", ");
+        report_number("max", bench[i].max);
+        report_puts("}");
+    }
+    report_puts("\r\n  }\r\n}\r\n");
+}
+
+
+/**********************************************************************
+ * Function: Main function where the program execution begins
+ * Purpose:  Measure all hot paths, send the report and stop.
+ * Returns:  none
+ **********************************************************************/
+int main(void)
+{
+    GPIO_mode_output(&DDRB, PB5);
+    uart_init(UART_BAUD_AUTO);
+    lcd_init(LCD_DISP_ON);
+
+    // ADC waits for Timer/Counter0 overflow, which never comes, so the
+    // handler runs only when called here
+    adc_init(&bench_channel, 1, ADC_TRIGGER_TIM0_OVF);
+
+    // Timer/Counter1 counts CPU cycles, overflow every 4 ms
+    TCCR1A = 0;
+    TCCR1B = (1<<CS10);
+
+    // Instructions queued by lcd_init() are written before any measurement
+    lcd_drain();
+    cli();
+    bench_calibrate();
+
+    BENCH("GPIO_read", , sink = GPIO_read(&PINB, PB4));
+    BENCH("GPIO_write_high", , GPIO_write_high(&PORTB, PB5));
+    BENCH("lfsr4_fibonacci_asm", , sink = lfsr4_fibonacci_asm(sink));
+    BENCH("uart_putc", uart_reset(), uart_putc('x'));
+    BENCH("uart_write_16", uart_reset(), uart_write(bench_data, 16));
+    BENCH("frame_send_3", uart_reset(), frame_send(0x01, bench_data, 3));
+    BENCH("uart_udre_isr", uart_one_space(), USART_UDRE_vect());
+    BENCH("adc_isr", adc_empty(), ADC_vect());
+    BENCH("lcd_gotoxy", lcd_drain(), lcd_gotoxy(0, 1));
+    BENCH("lcd_putc", lcd_drain(), lcd_putc('x'));
+#if LCD_ASYNC
+    // One nibble of the write queue
+    BENCH("lcd_timer2_isr", lcd_one_entry(), TIMER2_COMPA_vect());
+#endif
+
+    // Send the report and wait for its last byte
+    uart_reset();
+    sei();
+    report();
+    loop_until_bit_is_clear(UCSR0B, UDRIE0);
+    _delay_ms(1);
+
+    // Sleeping with interrupts disabled ends the simulation
+    cli();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sleep_cpu();
+
+    // Will never reach this
+    return 0;
+}
@@ -2,10 +2,14 @@
 #include <avr/interrupt.h>  // Interrupts standard C library for AVR-GCC
 #include <gpio.h>           // GPIO library for AVR-GCC
 #include "timer.h"          // Timer library for AVR-GCC
-#include <stdlib.h>         // C library. Needed for number conversions
 #include <lcd.h>            // Peter Fleury's LCD library
+#include <lcd_fb.h>         // Frame buffer layer for LCD library
 #include <uart.h>           // Peter Fleury's UART library
-#include <util/delay.h>     // Functions for busy-wait delay loops
+#include <frame.h>          // Binary telemetry frames over UART
+#include <adc.h>            // Auto-triggered ADC sampling
+#include <isrstat.h>        // ISR execution time statistics, -DISRSTAT=1
+#include <sched.h>          // Events from ISRs handled by main loop
+#include <string.h>         // C library for string handling
 
 #define SW   PD2            // Pin D2  - Digital pin for button on Joystick
 #define LED  PB5            // Pin D13 - LED indicate
@@ -16,6 +20,23 @@
 #define DT   PB3            // Pin D11 - Digital pin for DT encoder pin
 #define CLK  PB4            // Pin D12 - Digital pin for CLK encoder pin
 
+#define FRAME_CURSOR 0x01   // Telemetry frame type, payload: line, column, symbol
+#define FRAME_ISRSTAT 0x02  // Telemetry frame type, payload: id, count, min, avg, max, latency
+#define FRAME_SAMPLES 0x03  // Telemetry frame type, payload: 16-bit samples, ADC channel in bits 15..12
+
+#ifndef SAMPLE_STREAM
+# define SAMPLE_STREAM 0    // 1: send every joystick sample by UART ping-pong buffers, see [env:stream]
+#endif
+#if SAMPLE_STREAM
+# define STREAM_SAMPLES ((UART_PP_BUFFER_SIZE - FRAME_ENCODED_SIZE(0)) / 2)  // Encoded frame fills one ping-pong buffer
+#endif
+
+#define ISR_TIMER1 0        // Number of Timer/Counter1 overflow routine in isrstat
+
+#define EV_ENCODER 0        // Event with encoder pins (PINB) sampled every 33 ms
+#define EV_TICK    1        // Event every 33 ms, after EV_ENCODER
+#define JOYSTICK_HOLD 3     // Ticks (100 ms) between two moves of the symbol
+
 
 /* Main function -----------------------------------------------------*/
 /**********************************************************************
@@ -24,11 +45,27 @@
  **********************************************************************/
 
 /*Global variables----------------------------------------------------*/
-    uint8_t symbol = 0x2a;                      // Symbol value
+    uint8_t symbol = 0x2a;                      // Symbol value, changed by encoder
     uint8_t line = 0;                           // Constant for LCD lines (0-15)    | uint8_t range is 0 to 255
     uint8_t column = 0;                         // Constant for LCD columns (0-1)
     uint8_t pinALast;                           // Last value of CLK pin on the encoder
 
+    const uint8_t joystick[2] = {PINX, PINY};   // ADC channels of X and Y coordinates, ADC0 and ADC1
+    uint32_t sum[2] = {0, 0};                   // Sum of samples since the last tick
+    uint16_t count[2] = {0, 0};                 // Number of samples since the last tick
+#if SAMPLE_STREAM
+    uint8_t stream[2 * STREAM_SAMPLES];         // Payload of FRAME_SAMPLES being collected
+    uint8_t stream_count = 0;                   // Number of samples in stream
+    uint8_t *stream_buf;                        // Ping-pong buffer the next frame is encoded to
+#endif
+
+/* Function prototypes -----------------------------------------------*/
+void encoder_update(uint16_t pins);
+void tick_update(uint16_t value);
+void joystick_update(uint16_t x, uint16_t y);
+void isrstat_send(void);
+void stream_sample(uint8_t channel, uint16_t value);
+
 int main(void)
 {
     GPIO_mode_input_pullup(&DDRD, SW);              // Set pin for Joystick button, where on-board LED is connected as input with pullup resistor
@@ -42,27 +79,25 @@ int main(void)
 
     pinALast = GPIO_read(&PINB, CLK);               // Remembers the last encoder position
 
-    uart_init(UART_BAUD_SELECT(9600, F_CPU));       // Initialize USART to asynchronous, 8N1, 9600
+    uart_init(UART_BAUD_AUTO);                      // Initialize USART to asynchronous, 8N1, UART_BAUD from platformio.ini
+#if SAMPLE_STREAM
+    stream_buf = uart_pp_buffer();                  // First frame of samples is encoded here
+#endif
     lcd_init(LCD_DISP_ON);                          // Initialize LCD display without any cursor
+    lcd_fb_init();                                  // Symbol is drawn to frame buffer, flushed every tick
+    isrstat_init();                                 // Clear ISR statistics
 
-    // Configure Analog-to-Digital Convertion unit
-    // Select ADC voltage reference to "AVcc with external capacitor at AREF pin"
-    ADMUX |=  (1<<REFS0); 
-    ADMUX &= ~(1<<REFS1);       
-
-    // Select input channel ADC0 (voltage divider pin)
-    ADMUX &= ~((1<<MUX3) | (1<<MUX2) | (1<<MUX1) | (1<<MUX0));        
-
-    // Enable ADC module
-    ADCSRA |= (1<<ADEN);
+    sched_init();                                   // Work posted by Timer1 interrupt is done by main loop
+    sched_handler(EV_ENCODER, encoder_update);
+    sched_handler(EV_TICK, tick_update);
 
-    // Enable conversion complete interrupt
-    ADCSRA |= (1<<ADIE);
+    // Configure Analog-to-Digital Convertion unit
+    // Convert X and Y coordinates in turn, 500 samples per second of each,
+    // AVcc reference, prescaler 128. Conversions are started by
+    // Timer/Counter0 compare match in hardware, no interrupt is used
+    adc_init_rate(joystick, 2, 500);
 
-    // Set clock prescaler to 128
-    ADCSRA |= ((1<<ADPS0) | (1<<ADPS1) | (1<<ADPS2));    
-    
-    // Configure 16-bit Timer/Counter1 to start ADC conversion
+    // Configure 16-bit Timer/Counter1 to read encoder and move the symbol
     // Set prescaler to 33 ms and enable overflow interrupt
     TIM1_overflow_33ms();                       
     TIM1_overflow_interrupt_enable();           
@@ -70,10 +105,30 @@ int main(void)
     // Enables interrupts by setting the global interrupt mask
     sei(); 
 
+    uint16_t value;
+    uint8_t i;
+    char *command;
+
     // Infinite loop
     while (1)       
     {    
-    // All actions are performed in this loop         
+        sched_run();                                // Handle events posted by interrupts, encoder first
+
+        for (i = 0; i < 2; i++)                     // Empty ring buffers of both coordinates
+        {
+            while (adc_get(i, &value))
+            {
+                sum[i] += value;
+                count[i]++;
+#if SAMPLE_STREAM
+                stream_sample(i, value);
+#endif
+            }
+        }
+
+        command = uart_getline();                   // Whole line assembled by UART interrupt, -DUART_RX_LINE_MODE=1
+        if (command && strcmp(command, "?") == 0)   // Send ISR statistics on request, corrupted lines are dropped
+            isrstat_send();
     }
 
     // Will never reach this
@@ -83,17 +138,31 @@ int main(void)
 /* Interrupt service routines ----------------------------------------*/
 /**********************************************************************
  * Function: Timer/Counter1 overflow interrupt
- * Purpose:  Use single conversion mode and start conversion every 100 ms.
+ * Purpose:  Sample encoder pins and post events for main loop, which
+ *           moves the symbol every 33 ms.
  **********************************************************************/
 
 ISR(TIMER1_OVF_vect)
 {
-    ADCSRA |= (1<<ADSC);                            // Start ADC conversion     
-    
+    ISRSTAT_ENTER_AT(ISR_TIMER1, 0);                // Overflow is at TCNT1 = 0, empty without -DISRSTAT=1
+    sched_post_data(EV_ENCODER, PINB);              // Only capture encoder pins, main loop decodes them
+    sched_post(EV_TICK);                            // Main loop moves the symbol and writes LCD
+    ISRSTAT_EXIT(ISR_TIMER1);
+}
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: encoder_update()
+ * Purpose:  Change the symbol by encoder, handler of EV_ENCODER.
+ * Input(s): pins - Value of PINB sampled by Timer/Counter1 interrupt
+ * Returns:  none
+ **********************************************************************/
+void encoder_update(uint16_t pins)
+{
     uint8_t aVal;                                   // Actual value of CLK pin
-    aVal = GPIO_read(&PINB, CLK);                   // Reading actual position of encoder
+    aVal = (pins >> CLK) & 1;                       // Actual position of encoder sampled by interrupt
 
-    if (!GPIO_read(&PINB, SW1))                     // Encoder button reading condition
+    if (!(pins & (1 << SW1)))                       // Encoder button reading condition
         {
             GPIO_write_high(&PORTB, LED);           // Turning on the LED (just indicate that button on encoder is pressed)        
             symbol = 0x21;                          // First value, which is a symbol `!`
@@ -101,7 +170,7 @@ ISR(TIMER1_OVF_vect)
 
     if (aVal != pinALast)                           // The knob is rotating, if the knob is rotating, we need to determine direction, we do that by reading pin B
         {
-            if (GPIO_read(&PINB, DT) != aVal)       // Means pin A Changed first - We're Rotating Clockwise
+            if (((pins >> DT) & 1) != aVal)         // Means pin A Changed first - We're Rotating Clockwise
             {
                 if(symbol < 0xff)                   // The condition when the symbol can reach the maximum value, i.e. 255
                 {
@@ -125,18 +194,42 @@ ISR(TIMER1_OVF_vect)
             }
             pinALast = aVal;                        // Assigning the read value to the last one to determine the direction of rotation
         }
-        
-    lcd_gotoxy(line, column);                       // Going to x, y position on LCD
-    lcd_putc(symbol);                               // Writing the definite symbol         
-        
 }
 
 /**********************************************************************
- * Function: ADC complete interrupt
- * Purpose:  Display converted value on LCD screen.
+ * Function: tick_update()
+ * Purpose:  Move the symbol by the mean of joystick samples and send
+ *           the changed cells of the frame buffer to LCD, handler of
+ *           EV_TICK every 33 ms.
+ * Input(s): value - Not used
+ * Returns:  none
  **********************************************************************/
+void tick_update(uint16_t value)
+{
+    static uint16_t mean[2] = {512, 512};           // Neutral position of joystick until the first samples
+    uint8_t i;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (count[i] != 0)
+            mean[i] = sum[i] / count[i];
+        sum[i] = 0;
+        count[i] = 0;
+    }
+    joystick_update(mean[0], mean[1]);
+
+    lcd_fb_putc(line, column, symbol);              // Writing the symbol selected by encoder
+    lcd_fb_flush();                                 // Only the old and the new cell are sent, no clear display
+}
 
-ISR(ADC_vect)
+/**********************************************************************
+ * Function: joystick_update()
+ * Purpose:  Move the symbol on LCD screen by joystick position.
+ * Input(s): x - Mean ADC value of X coordinate since the last call
+ *           y - Mean ADC value of Y coordinate since the last call
+ * Returns:  none
+ **********************************************************************/
+void joystick_update(uint16_t x, uint16_t y)
 {
     GPIO_read(&PIND, SW);                           // Reading data from Joystick Button
     GPIO_read(&PINC, PINX);                         // Reading value (voltage) from Joystick X coordinate
@@ -144,117 +237,155 @@ ISR(ADC_vect)
     GPIO_write_low(&PORTB, LED);                    // Turning off LED port or low level
     
     static uint8_t marker = 0;                      // One time using constant for position of first symbol 
+    static uint8_t hold = 0;                        // Ticks to ignore joystick after the symbol moved
     
     uint16_t value;                                 // Constant which shows 2 direction for ADC (0-1024)          | uint16_t range is 0 to 32 767
-    char string[4];                                 // String for converted numbers by itoa() | ADC conversion
-    char str[4];                                    // String for converted numbers by itoa() | UART printing
+    uint8_t cursor[3];                              // Payload of telemetry frame | UART printing
 
     if (marker == 0)                                // Inicialized only ones when program is started
     {
         marker = 1;                                 // Incrementing MARKER to value which will never reach 
-        lcd_gotoxy(line, column);                   // Going to x,y position on LCD, 16x2
-        lcd_putc(symbol);                           // Writes a symbol to the designated cell 
+        lcd_fb_putc(line, column, symbol);          // Writes a symbol to the designated cell of 16x2 LCD
     }
 
     if (!GPIO_read(&PIND, SW))                      // Joystick button reading condition
     {
         GPIO_write_high(&PORTB, LED);               // Turning on the LED (just indicate that button is pressed)
 
-        lcd_gotoxy(line, column);           
-        lcd_putc(0xef);                             // Writing the definite symbol
+        lcd_fb_putc(line, column, 0xef);            // Writing the definite symbol
     }
 
-    switch (ADMUX)                                  // Important condition, which needs to define ports between ADC0 and ADC1 for ADC Conversion (it's all a last digit) 
+    if (hold)                                       // Symbol moved recently, joystick is taken as neutral
     {
-        case 0b01000000:                            // Turning on the port ADC0 that has amount 0100 0000        
-        value = ADC;                                // Read converted value
+        hold--;
+        x = 512;
+        y = 512;
+    }
 
-        itoa(value, string, 10);                    // Convert VALUE to STRING at Decimal 
-        if (value > 900)                            // Condition if we are moving to the Right side on LCD
-        {
-            GPIO_write_high(&PORTB, LED);           // Turning on the LED
+    // X coordinate, channel ADC0
+    value = x;
+    if (value > 900)                                // Condition if we are moving to the Right side on LCD
+    {
+        GPIO_write_high(&PORTB, LED);               // Turning on the LED
 
-            lcd_clrscr();                           // Clear LCD display
-            _delay_ms(50);
+        lcd_fb_clear();                             // Clear frame buffer of LCD display
                                                     // Incrementing LINE by 1
-            if (line < 15)                          // Condition of movement on a row to the right
-            {
-                line++;
-                lcd_gotoxy(line, column);
-                lcd_putc(symbol);                
-            }
-                      
-            _delay_ms(50);                          // Delay to return the button to its original position
-        }
-        if (value < 100)                            // Condition if we are moving to the Left side on LCD
+        if (line < 15)                              // Condition of movement on a row to the right
         {
-            GPIO_write_high(&PORTB, LED);
+            line++;
+            lcd_fb_putc(line, column, symbol);
+        }
+                  
+        hold = JOYSTICK_HOLD;                       // Ignore joystick for 100 ms to let it return, no busy wait
+    }
+    if (value < 100)                                // Condition if we are moving to the Left side on LCD
+    {
+        GPIO_write_high(&PORTB, LED);
 
-            lcd_clrscr();
-            _delay_ms(50);
+        lcd_fb_clear();
                                                     // Reduction LINE by 1
-            if (line > 0)                          // Condition of movement on a row to the left
-            {
-                line--;
-                lcd_gotoxy(line, column);
-                lcd_putc(symbol);                
-            }
-             
-            _delay_ms(50);
+        if (line > 0)                              // Condition of movement on a row to the left
+        {
+            line--;
+            lcd_fb_putc(line, column, symbol);
         }
-        ADMUX = 0b01000001;                         // At the end of the loop, change port ADC0 to ADC1
-
-        itoa(line, str, 10);                        // Convert LINE to STR at Decimal
-        uart_puts("Line is: ");                     // Write on UART
-        uart_puts(str);                             // Display the row on UART        
-        break;                                      // Stop the first condition of CASE
+         
+        hold = JOYSTICK_HOLD;                       // Ignore joystick for 100 ms to let it return, no busy wait
+    }
 
+    // Y coordinate, channel ADC1
+    value = y;
+    if (value > 900)                                // Condition if we are moving to the down on LCD
+    {
+        GPIO_write_high(&PORTB, LED);
 
-        case 0b01000001:                            // Turning on the port ADC1 that has amount 0100 0001
-        value = ADC;                                // Read converted value
-       
-        itoa(value, string, 10);   
-        if (value > 900)                            // Condition if we are moving to the down on LCD
+        lcd_fb_clear();
+                                                    // Incrementing COLUMN by 1. Actually LCD has just 2 columns, which is 0 and 1
+        if (column < 1)                             // Condition if we are changing column on LCD
         {
-            GPIO_write_high(&PORTB, LED);
+            column++;
+            lcd_fb_putc(line, column, symbol);
+        }
+                 
+        hold = JOYSTICK_HOLD;                       // Ignore joystick for 100 ms to let it return, no busy wait
+    }
+    if (value < 100)                                // Condition if we are moving to the up on LCD
+    {
+        GPIO_write_high(&PORTB, LED);
 
-            lcd_clrscr();
-            _delay_ms(50);
-                                                    // Incrementing COLUMN by 1. Actually LCD has just 2 columns, which is 0 and 1
-            if (column < 1)                         // Condition if we are changing column on LCD
-            {
-                column++;
-                lcd_gotoxy(line, column);
-                lcd_putc(symbol);                
-            }
-                     
-            _delay_ms(50);
+        lcd_fb_clear();
+                                                    // Reduction COLUMN by 1
+        if (column > 0)
+        {
+            column--;
+            lcd_fb_putc(line, column, symbol);
         }
-        if (value < 100)                            // Condition if we are moving to the up on LCD
+                   
+        hold = JOYSTICK_HOLD;                       // Ignore joystick for 100 ms to let it return, no busy wait
+    }        
+
+    cursor[0] = line;                               // Send position of the cursor on UART as one binary frame
+    cursor[1] = column;                             // instead of "Line is: / Column is: " text,
+    cursor[2] = symbol;                             // decoded on PC by tools/frame_decode.c
+    frame_send(FRAME_CURSOR, cursor, sizeof(cursor));
+}
+
+/**********************************************************************
+ * Function: isrstat_send()
+ * Purpose:  Send statistics of instrumented ISRs as telemetry frames,
+ *           times in Timer/Counter1 ticks (0.5 us). Decoded on PC by
+ *           tools/frame_decode.c.
+ * Returns:  none
+ **********************************************************************/
+void isrstat_send(void)
+{
+    isrstat_t stat;
+    uint16_t field[5];
+    uint8_t payload[11];                            // id and five 16-bit fields, little endian
+    uint8_t id;
+    uint8_t i;
+
+    for (id = 0; id < ISRSTAT_VECTORS; id++)
+    {
+        isrstat_get(id, &stat);
+        field[0] = stat.count;
+        field[1] = stat.count ? stat.min : 0;
+        field[2] = isrstat_avg(&stat);
+        field[3] = stat.max;
+        field[4] = stat.latency;
+
+        payload[0] = id;
+        for (i = 0; i < 5; i++)
         {
-            GPIO_write_high(&PORTB, LED);
+            payload[1 + 2 * i] = field[i] & 0xff;
+            payload[2 + 2 * i] = field[i] >> 8;
+        }
+        frame_send(FRAME_ISRSTAT, payload, sizeof(payload));
+    }
+}
 
-            lcd_clrscr();
-            _delay_ms(50);
-                                                    // Reduction COLUMN by 1
-            if (column > 0)
-            {
-                column--;
-                lcd_gotoxy(line, column);
-                lcd_putc(symbol);                
-            }
-                       
-            _delay_ms(50);
-        }        
-        ADMUX = 0b01000000;                         // Again change port from ADC1 to ADC0
-
-        itoa(column, str, 10);
-        uart_puts("      Column is: ");
-        uart_puts(str);                             // Display the column on UART
-        uart_puts(" \r\n");                         // Go to the new line and move the cursor in the beginning position of line
-        break;                                      // Stop the second condition of CASE
-
-        default:                                    // Each case should have the default condition which is empty
-        break;
+#if SAMPLE_STREAM
+/**********************************************************************
+ * Function: stream_sample()
+ * Purpose:  Collect one joystick sample. Every STREAM_SAMPLES samples
+ *           are encoded as one FRAME_SAMPLES frame directly into UART
+ *           ping-pong buffer, which UDRE interrupt sends while the next
+ *           frame is collected. Frames the UART cannot keep up with are
+ *           dropped and counted by uart_pp_overruns().
+ * Input(s): channel - Index of ADC channel, 0 for X, 1 for Y
+ *           value - 10-bit sample
+ * Returns:  none
+ **********************************************************************/
+void stream_sample(uint8_t channel, uint16_t value)
+{
+    value |= (uint16_t) channel << 12;
+    stream[2 * stream_count] = value & 0xff;
+    stream[2 * stream_count + 1] = value >> 8;
+
+    if (++stream_count == STREAM_SAMPLES)
+    {
+        stream_count = 0;
+        stream_buf = uart_pp_swap(frame_encode(stream_buf, FRAME_SAMPLES, stream, sizeof(stream)));
     }
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef MOCK_AVR_INTERRUPT_H
+# define MOCK_AVR_INTERRUPT_H
+
+/***********************************************************************
+ *
+ * Host replacement of <avr/interrupt.h> for unit tests of the libraries.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @brief Interrupt handlers become ordinary functions.
+ *
+ * ISR(TWI_vect) defines function TWI_vect(), which a test calls to run
+ * the handler once. sei() and cli() only change the I flag of the
+ * mocked SREG.
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <avr/io.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void) { }
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+
+#define sei() (SREG |= _BV(SREG_I))
+#define cli() (SREG &= (uint8_t) ~_BV(SREG_I))
+
+
+/* Function prototypes -----------------------------------------------*/
+/* Handlers defined by the libraries */
+void ADC_vect(void);
+void TIMER2_COMPA_vect(void);
+void TWI_vect(void);
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+
+#endif
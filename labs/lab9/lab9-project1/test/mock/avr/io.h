@@ -0,0 +1,252 @@
+#ifndef MOCK_AVR_IO_H
+# define MOCK_AVR_IO_H
+
+/***********************************************************************
+ *
+ * Host replacement of <avr/io.h> for unit tests of the libraries.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @brief RAM-backed I/O registers of ATmega328P.
+ *
+ * Every register is a byte of mock_sfr[] at its data memory address,
+ * so DDR(x) and PIN(x) address arithmetic of the libraries works. No
+ * hardware behaviour is simulated: a test sets status and data
+ * registers, calls the library or an interrupt handler, and checks
+ * what was written to the control registers. Call mock_sfr_reset()
+ * from setUp().
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+
+/* Variables ---------------------------------------------------------*/
+/** @brief Register file, weak so that every test file may include it */
+__attribute__((weak, aligned(2))) volatile uint8_t mock_sfr[0x100];
+
+/** @brief 16-bit register access, may alias the register file */
+typedef uint16_t __attribute__((may_alias)) mock_sfr16_t;
+
+
+/* Defines -----------------------------------------------------------*/
+#ifndef __AVR_ATmega328P__
+# define __AVR_ATmega328P__ 1
+#endif
+
+#define _SFR_MEM8(addr)  (mock_sfr[(addr)])
+#define _SFR_MEM16(addr) (*(volatile mock_sfr16_t *) &mock_sfr[(addr)])
+#define _SFR_IO8(addr)   _SFR_MEM8((addr) + 0x20)
+#define _SFR_IO16(addr)  _SFR_MEM16((addr) + 0x20)
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit)   ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit)   do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+#define RAMEND 0x8FF
+
+/* Ports */
+#define PINB   _SFR_IO8(0x03)
+#define DDRB   _SFR_IO8(0x04)
+#define PORTB  _SFR_IO8(0x05)
+#define PINC   _SFR_IO8(0x06)
+#define DDRC   _SFR_IO8(0x07)
+#define PORTC  _SFR_IO8(0x08)
+#define PIND   _SFR_IO8(0x09)
+#define DDRD   _SFR_IO8(0x0A)
+#define PORTD  _SFR_IO8(0x0B)
+
+/* Timers, ADC and status register */
+#define TIFR0  _SFR_IO8(0x15)
+#define TIFR1  _SFR_IO8(0x16)
+#define TIFR2  _SFR_IO8(0x17)
+#define TCCR0A _SFR_IO8(0x24)
+#define TCCR0B _SFR_IO8(0x25)
+#define TCNT0  _SFR_IO8(0x26)
+#define OCR0A  _SFR_IO8(0x27)
+#define OCR0B  _SFR_IO8(0x28)
+#define SREG   _SFR_IO8(0x3F)
+#define TIMSK0 _SFR_MEM8(0x6E)
+#define TIMSK1 _SFR_MEM8(0x6F)
+#define TIMSK2 _SFR_MEM8(0x70)
+#define ADC    _SFR_MEM16(0x78)
+#define ADCW   ADC
+#define ADCL   _SFR_MEM8(0x78)
+#define ADCH   _SFR_MEM8(0x79)
+#define ADCSRA _SFR_MEM8(0x7A)
+#define ADCSRB _SFR_MEM8(0x7B)
+#define ADMUX  _SFR_MEM8(0x7C)
+#define DIDR0  _SFR_MEM8(0x7E)
+#define TCCR1A _SFR_MEM8(0x80)
+#define TCCR1B _SFR_MEM8(0x81)
+#define TCCR1C _SFR_MEM8(0x82)
+#define TCNT1  _SFR_MEM16(0x84)
+#define ICR1   _SFR_MEM16(0x86)
+#define OCR1A  _SFR_MEM16(0x88)
+#define OCR1B  _SFR_MEM16(0x8A)
+#define TCCR2A _SFR_MEM8(0xB0)
+#define TCCR2B _SFR_MEM8(0xB1)
+#define TCNT2  _SFR_MEM8(0xB2)
+#define OCR2A  _SFR_MEM8(0xB3)
+#define OCR2B  _SFR_MEM8(0xB4)
+
+/* TWI */
+#define TWBR   _SFR_MEM8(0xB8)
+#define TWSR   _SFR_MEM8(0xB9)
+#define TWAR   _SFR_MEM8(0xBA)
+#define TWDR   _SFR_MEM8(0xBB)
+#define TWCR   _SFR_MEM8(0xBC)
+
+/* USART0 */
+#define UCSR0A _SFR_MEM8(0xC0)
+#define UCSR0B _SFR_MEM8(0xC1)
+#define UCSR0C _SFR_MEM8(0xC2)
+#define UBRR0  _SFR_MEM16(0xC4)
+#define UBRR0L _SFR_MEM8(0xC4)
+#define UBRR0H _SFR_MEM8(0xC5)
+#define UDR0   _SFR_MEM8(0xC6)
+
+/* Bits */
+#define SREG_I 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define TOV0   0
+#define OCF0A  1
+#define OCF0B  2
+#define TOIE0  0
+#define OCIE0A 1
+#define OCIE0B 2
+#define TOV1   0
+#define OCF1A  1
+#define OCF1B  2
+#define ICF1   5
+#define TOIE1  0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1  5
+#define TOV2   0
+#define OCF2A  1
+#define OCF2B  2
+#define TOIE2  0
+#define OCIE2A 1
+#define OCIE2B 2
+
+#define WGM00  0
+#define WGM01  1
+#define WGM02  3
+#define CS00   0
+#define CS01   1
+#define CS02   2
+#define WGM10  0
+#define WGM11  1
+#define WGM12  3
+#define WGM13  4
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define WGM20  0
+#define WGM21  1
+#define CS20   0
+#define CS21   1
+#define CS22   2
+
+#define MUX0   0
+#define MUX1   1
+#define MUX2   2
+#define MUX3   3
+#define ADLAR  5
+#define REFS0  6
+#define REFS1  7
+#define ADPS0  0
+#define ADPS1  1
+#define ADPS2  2
+#define ADIE   3
+#define ADIF   4
+#define ADATE  5
+#define ADSC   6
+#define ADEN   7
+#define ADTS0  0
+#define ADTS1  1
+#define ADTS2  2
+
+#define TWIE   0
+#define TWEN   2
+#define TWWC   3
+#define TWSTO  4
+#define TWSTA  5
+#define TWEA   6
+#define TWINT  7
+#define TWPS0  0
+#define TWPS1  1
+
+#define MPCM0  0
+#define U2X0   1
+#define UPE0   2
+#define DOR0   3
+#define FE0    4
+#define UDRE0  5
+#define TXC0   6
+#define RXC0   7
+#define TXB80  0
+#define RXB80  1
+#define UCSZ02 2
+#define TXEN0  3
+#define RXEN0  4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCPOL0 0
+#define UCSZ00 1
+#define UCSZ01 2
+#define USBS0  3
+#define UPM00  4
+#define UPM01  5
+
+
+/* Function definitions ----------------------------------------------*/
+/**
+ * @brief  Clear all registers.
+ * @return none
+ */
+static inline void mock_sfr_reset(void)
+{
+    memset((void *) mock_sfr, 0, sizeof(mock_sfr));
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef MOCK_AVR_PGMSPACE_H
+# define MOCK_AVR_PGMSPACE_H
+
+/***********************************************************************
+ *
+ * Host replacement of <avr/pgmspace.h> for unit tests of the libraries.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+/**
+ * @file
+ * @brief Program memory is ordinary memory on the host.
+ */
+
+
+/* Includes ----------------------------------------------------------*/
+#include <stdint.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *) (addr))
+#define pgm_read_word(addr) (*(const uint16_t *) (addr))
+
+#endif
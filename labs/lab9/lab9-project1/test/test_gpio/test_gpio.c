@@ -0,0 +1,84 @@
+/***********************************************************************
+ *
+ * Unit tests of the GPIO library on mocked registers, run by
+ * "pio test -e native".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <gpio.h>
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+}
+
+
+void tearDown(void)
+{
+}
+
+
+void test_mode_output_sets_one_ddr_bit(void)
+{
+    DDRB = _BV(PB0);
+    GPIO_mode_output(&DDRB, PB5);
+
+    TEST_ASSERT_EQUAL_HEX8(_BV(PB0) | _BV(PB5), DDRB);
+    TEST_ASSERT_EQUAL_HEX8(0, PORTB);
+}
+
+
+void test_input_pullup_writes_ddr_and_port(void)
+{
+    // Data Register follows Data Direction Register of the same port
+    DDRD = 0xFF;
+    PORTD = _BV(PD7);
+    GPIO_mode_input_pullup(&DDRD, PD2);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF & ~_BV(PD2), DDRD);
+    TEST_ASSERT_EQUAL_HEX8(_BV(PD7) | _BV(PD2), PORTD);
+    TEST_ASSERT_EQUAL_HEX8(0, PIND);
+    TEST_ASSERT_EQUAL_HEX8(0, DDRC);
+}
+
+
+void test_write_changes_one_pin(void)
+{
+    PORTC = 0x0F;
+    GPIO_write_low(&PORTC, PC1);
+    TEST_ASSERT_EQUAL_HEX8(0x0D, PORTC);
+
+    GPIO_write_high(&PORTC, PC5);
+    TEST_ASSERT_EQUAL_HEX8(0x2D, PORTC);
+}
+
+
+void test_read_returns_pin_as_0_or_1(void)
+{
+    PIND = _BV(PD7) | _BV(PD2);
+
+    TEST_ASSERT_EQUAL_UINT8(1, GPIO_read(&PIND, PD7));
+    TEST_ASSERT_EQUAL_UINT8(1, GPIO_read(&PIND, PD2));
+    TEST_ASSERT_EQUAL_UINT8(0, GPIO_read(&PIND, PD3));
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_mode_output_sets_one_ddr_bit);
+    RUN_TEST(test_input_pullup_writes_ddr_and_port);
+    RUN_TEST(test_write_changes_one_pin);
+    RUN_TEST(test_read_returns_pin_as_0_or_1);
+    return UNITY_END();
+}
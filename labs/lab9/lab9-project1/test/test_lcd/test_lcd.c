@@ -0,0 +1,163 @@
+/***********************************************************************
+ *
+ * Unit tests of the interrupt driven LCD write queue on mocked
+ * registers, run by "pio test -e native".
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <lcd.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define LCD_DATA_MASK (0x0F << LCD_DATA0_PIN)
+
+/* Timer/Counter2 ticks of 16 us, rounded up as OCR2A is loaded */
+#define TICKS(us) ((uint8_t)((F_CPU / 256UL * (us) + 999999UL) / 1000000UL))
+
+
+/* Variables ---------------------------------------------------------*/
+static uint8_t data[16];  // Bytes written to the controller
+static uint8_t rs[16];    // RS line of each byte
+static uint8_t wait[16];  // OCR2A after the low nibble of each byte
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+}
+
+
+void tearDown(void)
+{
+    // Empty the queue, a failed test must not leave bytes to the next
+    TIMSK2 |= _BV(OCIE2A);
+    while (TIMSK2 & _BV(OCIE2A))
+        TIMER2_COMPA_vect();
+}
+
+
+/* Run the compare match interrupt until the queue is empty and collect
+   the bytes from the data nibbles and RS line after every match */
+static uint8_t drain(void)
+{
+    uint8_t n = 0;
+    uint8_t low = 0;
+
+    for (;;)
+    {
+        TCNT2 = 0x55;
+        TIMER2_COMPA_vect();
+        if (!(TIMSK2 & _BV(OCIE2A)))
+            break;
+
+        TEST_ASSERT_EQUAL_UINT8(0, TCNT2);
+        TEST_ASSERT_BITS_LOW(_BV(LCD_E_PIN), LCD_E_PORT);
+        if (!low)
+        {
+            TEST_ASSERT_TRUE(n < sizeof(data));
+            data[n] = (LCD_DATA0_PORT & LCD_DATA_MASK) >> LCD_DATA0_PIN << 4;
+            rs[n] = (LCD_RS_PORT >> LCD_RS_PIN) & 1;
+            TEST_ASSERT_EQUAL_UINT8(0, OCR2A);
+        }
+        else
+        {
+            data[n] |= (LCD_DATA0_PORT & LCD_DATA_MASK) >> LCD_DATA0_PIN;
+            TEST_ASSERT_EQUAL_UINT8(rs[n], (LCD_RS_PORT >> LCD_RS_PIN) & 1);
+            wait[n] = OCR2A;
+            n++;
+        }
+        low ^= 1;
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, low);
+    return n;
+}
+
+
+void test_init_sets_pins_and_timer(void)
+{
+    lcd_init(LCD_DISP_ON);
+
+    TEST_ASSERT_BITS_HIGH(LCD_DATA_MASK, DDRD);
+    TEST_ASSERT_BITS_HIGH(_BV(LCD_RS_PIN) | _BV(LCD_E_PIN), DDRB);
+
+    // Function set to 4-bit interface is written directly, the rest queued
+    TEST_ASSERT_EQUAL_HEX8(0x02, (LCD_DATA0_PORT & LCD_DATA_MASK) >> LCD_DATA0_PIN);
+    TEST_ASSERT_EQUAL_HEX8(_BV(WGM21), TCCR2A);
+    TEST_ASSERT_EQUAL_HEX8(_BV(CS22) | _BV(CS21), TCCR2B);
+    TEST_ASSERT_EQUAL_UINT8(TICKS(LCD_DELAY_INIT_4BIT), OCR2A);
+    TEST_ASSERT_BITS_HIGH(_BV(OCIE2A), TIMSK2);
+
+    drain();
+}
+
+
+void test_init_gotoxy_putc_sequence(void)
+{
+    static const uint8_t expect[] = {
+        LCD_FUNCTION_4BIT_2LINES, LCD_DISP_OFF, 1 << LCD_CLR,
+        LCD_MODE_DEFAULT, LCD_DISP_ON,
+        (1 << LCD_DDRAM) + LCD_START_LINE2 + 3, 'A'
+    };
+    static const uint8_t expect_rs[] = { 0, 0, 0, 0, 0, 0, 1 };
+    static const uint8_t expect_wait[] = {
+        TICKS(LCD_DELAY_WRITE), TICKS(LCD_DELAY_WRITE), TICKS(LCD_DELAY_CLEAR),
+        TICKS(LCD_DELAY_WRITE), TICKS(LCD_DELAY_WRITE),
+        TICKS(LCD_DELAY_WRITE), TICKS(LCD_DELAY_WRITE)
+    };
+
+    lcd_init(LCD_DISP_ON);
+    lcd_gotoxy(3, 1);
+    lcd_putc('A');
+
+    TEST_ASSERT_EQUAL_UINT8(sizeof(expect), drain());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expect, data, sizeof(expect));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expect_rs, rs, sizeof(expect));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expect_wait, wait, sizeof(expect));
+}
+
+
+void test_queue_keeps_other_port_pins(void)
+{
+    // Joystick button pull-up of lab9 shares PORTD with the data lines
+    PORTD = _BV(PD2) | _BV(PD3);
+    lcd_init(LCD_DISP_ON);
+    lcd_puts("ok");
+
+    TEST_ASSERT_EQUAL_UINT8(7, drain());
+    TEST_ASSERT_BITS_HIGH(_BV(PD2) | _BV(PD3), PORTD);
+}
+
+
+void test_idle_queue_restarts_on_write(void)
+{
+    lcd_init(LCD_DISP_ON);
+    drain();
+    TEST_ASSERT_BITS_LOW(_BV(OCIE2A), TIMSK2);
+
+    lcd_putc('x');
+    TEST_ASSERT_BITS_HIGH(_BV(OCIE2A), TIMSK2);
+    TEST_ASSERT_EQUAL_UINT8(1, drain());
+    TEST_ASSERT_EQUAL_CHAR('x', data[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, rs[0]);
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_sets_pins_and_timer);
+    RUN_TEST(test_init_gotoxy_putc_sequence);
+    RUN_TEST(test_queue_keeps_other_port_pins);
+    RUN_TEST(test_idle_queue_restarts_on_write);
+    return UNITY_END();
+}
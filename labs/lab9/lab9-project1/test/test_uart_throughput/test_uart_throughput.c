@@ -0,0 +1,133 @@
+/***********************************************************************
+ *
+ * Throughput tests of the UART transmit ringbuffer on mocked
+ * registers, run by "pio test -e native". The producer writes blocks
+ * while the Data Register Empty interrupt sends them, as in lab9 where
+ * tick_update() sends frames from the main loop.
+ *
+ * ATmega328P (Arduino Uno), 16 MHz, PlatformIO
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <unity.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <uart.h>
+
+
+/* Defines -----------------------------------------------------------*/
+#define BLOCK 10    // Bytes written at once by the producer
+#define BLOCKS 100  // Blocks of a stream, many times the ringbuffer
+
+
+/* Variables ---------------------------------------------------------*/
+static uint16_t sent;  // Bytes sent by the UDRE interrupt
+
+
+/* Function definitions ----------------------------------------------*/
+void setUp(void)
+{
+    mock_sfr_reset();
+    uart_init(UART_BAUD_SELECT(250000, F_CPU));
+    uart_tx_dropped();
+    sent = 0;
+}
+
+
+void tearDown(void)
+{
+}
+
+
+/* Run the UDRE interrupt up to n times, check that every call sends
+   the next byte of the stream, return the number of bytes sent */
+static uint16_t transmit(uint16_t n)
+{
+    uint16_t i;
+
+    for (i = 0; i < n && (UCSR0B & _BV(UDRIE0)); i++)
+    {
+        UDR0 = 0;
+        USART_UDRE_vect();
+        if (!(UCSR0B & _BV(UDRIE0)))
+            break;
+        TEST_ASSERT_EQUAL_UINT8((uint8_t) sent, UDR0);
+        sent++;
+    }
+    return i;
+}
+
+
+/* Write the next block of the stream, bytes count up from 0 */
+static void produce(uint16_t *next, uint8_t len)
+{
+    uint8_t block[BLOCK];
+    uint8_t i;
+
+    for (i = 0; i < len; i++)
+        block[i] = (uint8_t) (*next)++;
+    uart_write(block, len);
+}
+
+
+void test_one_byte_per_interrupt(void)
+{
+    uint16_t next = 0;
+
+    // One slot of the ring stays unused
+    while (next < UART_TX_BUFFER_SIZE - 1)
+        produce(&next, 1);
+
+    TEST_ASSERT_EQUAL_UINT(UART_TX_BUFFER_SIZE - 1, transmit(UART_TX_BUFFER_SIZE));
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+    TEST_ASSERT_EQUAL_UINT(0, uart_tx_dropped());
+}
+
+
+void test_stream_at_line_rate_loses_nothing(void)
+{
+    uint16_t next = 0;
+    uint16_t i;
+
+    // Line sends a block in the time the producer makes one, the
+    // write and read indexes wrap around the ring many times
+    for (i = 0; i < BLOCKS; i++)
+    {
+        produce(&next, BLOCK);
+        transmit(BLOCK);
+    }
+    transmit(BLOCK);
+
+    TEST_ASSERT_EQUAL_UINT(BLOCKS * BLOCK, sent);
+    TEST_ASSERT_EQUAL_UINT(0, uart_tx_dropped());
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+}
+
+
+void test_bursts_fill_ring_before_loss(void)
+{
+    uint16_t next = 0;
+
+    // Producer faster than the line, UART_TX_DROP keeps the oldest bytes
+    while (next < UART_TX_BUFFER_SIZE - 1)
+        produce(&next, 1);
+    produce(&next, BLOCK);
+
+    TEST_ASSERT_EQUAL_UINT(BLOCK, uart_tx_dropped());
+    TEST_ASSERT_EQUAL_UINT(UART_TX_BUFFER_SIZE - 1, transmit(UART_TX_BUFFER_SIZE));
+    TEST_ASSERT_BITS_LOW(_BV(UDRIE0), UCSR0B);
+}
+
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_byte_per_interrupt);
+    RUN_TEST(test_stream_at_line_rate_loses_nothing);
+    RUN_TEST(test_bursts_fill_ring_before_loss);
+    return UNITY_END();
+}
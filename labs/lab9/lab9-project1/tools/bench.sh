@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Build [env:bench], run it in simavr and store the JSON report of
+# cycle counts. With a baseline report, every hot path whose average
+# got slower is listed and the script fails. Cycle counts in simavr are
+# exact, so any increase is a real change.
+#
+# Usage, from the project directory:
+#   sh tools/bench.sh [report.json [baseline.json]]
+#
+# Needs PlatformIO (pio) and simavr in PATH.
+#
+# This work is licensed under the terms of the MIT license.
+#
+
+set -e
+
+REPORT=${1:-bench.json}
+BASELINE=$2
+ELF=.pio/build/bench/firmware.elf
+
+pio run -e bench
+
+# simavr prints UART output line by line with color escapes and stops
+# when the firmware sleeps with interrupts disabled
+timeout 60 simavr -m atmega328p -f 16000000 "$ELF" 2>&1 |
+    sed 's/\x1b\[[0-9;]*m//g' | tr -d '\r' |
+    sed -n '/^ *{$/,/^}$/p' | sed 's/^ *{$/{/' > "$REPORT"
+
+if [ ! -s "$REPORT" ]; then
+    echo "bench: no report from simavr" >&2
+    exit 1
+fi
+cat "$REPORT"
+
+[ -n "$BASELINE" ] || exit 0
+
+# Lines of hot paths look like: "name": {"min": 1, "avg": 2, "max": 3}
+awk -F'[":,{} ]+' '
+    /"avg"/ {
+        if (FILENAME == ARGV[1]) base[$2] = $6
+        else if (($2 in base) && $6 > base[$2]) {
+            printf "bench: %s avg %d -> %d cycles\n", $2, base[$2], $6
+            slower = 1
+        }
+    }
+    END { exit slower }
+' "$BASELINE" "$REPORT"
@@ -0,0 +1,248 @@
+/***********************************************************************
+ *
+ * Linux decoder of binary telemetry frames sent by lib/frame.
+ *
+ * Build and run on PC, not by PlatformIO:
+ *   cc -O2 -Wall -o frame_decode tools/frame_decode.c
+ *   ./frame_decode /dev/ttyACM0 250000
+ *
+ * Without arguments, frames are read from standard input, e.g. from
+ * a captured file. One line is printed for each valid frame, invalid
+ * frames are reported on standard error.
+ *
+ * This work is licensed under the terms of the MIT license.
+ *
+ **********************************************************************/
+
+
+/* Includes ----------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <asm/ioctls.h>     // TCGETS2, TCSETS2
+#include <asm/termbits.h>   // struct termios2 for any baud rate
+
+// <sys/ioctl.h> conflicts with <asm/termbits.h>
+int ioctl(int fd, unsigned long request, ...);
+
+
+/* Defines -----------------------------------------------------------*/
+#define FRAME_DELIMITER 0x00
+#define FRAME_CRC_INIT  0xFFFF
+#define FRAME_SIZE_MAX  256     // Longest encoded frame without delimiter
+
+#define FRAME_CURSOR    0x01    // Must match types in src/main.c
+#define FRAME_ISRSTAT   0x02
+#define FRAME_SAMPLES   0x03
+
+
+/* Function definitions ----------------------------------------------*/
+/**********************************************************************
+ * Function: serial_open()
+ * Purpose:  Open serial port in raw 8N1 mode with any baud rate.
+ * Input(s): path - Device, e.g. /dev/ttyACM0
+ *           baud - Baud rate
+ * Returns:  File descriptor, -1 on error
+ **********************************************************************/
+static int serial_open(const char *path, unsigned baud)
+{
+    struct termios2 tio;
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+
+    if (fd < 0)
+        return -1;
+    if (ioctl(fd, TCGETS2, &tio) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    tio.c_cflag = BOTHER | CS8 | CREAD | CLOCAL;
+    tio.c_ispeed = baud;
+    tio.c_ospeed = baud;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    if (ioctl(fd, TCSETS2, &tio) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+/**********************************************************************
+ * Function: crc16()
+ * Purpose:  Compute CRC-16/CCITT-FALSE, the same as _crc_xmodem_update()
+ *           from AVR libc with initial value 0xFFFF.
+ * Input(s): data - Data bytes
+ *           len - Number of data bytes
+ * Returns:  CRC value
+ **********************************************************************/
+static uint16_t crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = FRAME_CRC_INIT;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+
+/**********************************************************************
+ * Function: cobs_decode()
+ * Purpose:  Decode one COBS frame in place.
+ * Input(s): buf - Encoded frame without delimiter
+ *           len - Number of encoded bytes
+ * Returns:  Number of decoded bytes, -1 for malformed frame
+ **********************************************************************/
+static int cobs_decode(uint8_t *buf, size_t len)
+{
+    size_t src = 0;
+    size_t dst = 0;
+
+    while (src < len)
+    {
+        uint8_t code = buf[src++];
+
+        if (code == 0 || src + code - 1 > len)
+            return -1;
+        for (uint8_t i = 1; i < code; i++)
+            buf[dst++] = buf[src++];
+        // Block shorter than 254 bytes ends by zero, except the last one
+        if (code != 0xff && src < len)
+            buf[dst++] = 0;
+    }
+    return dst;
+}
+
+
+/**********************************************************************
+ * Function: frame_print()
+ * Purpose:  Check CRC of decoded frame and print its content.
+ * Input(s): buf - Decoded frame
+ *           len - Number of decoded bytes
+ * Returns:  0 for valid frame, -1 otherwise
+ **********************************************************************/
+static int frame_print(const uint8_t *buf, int len)
+{
+    const uint8_t *payload = buf + 1;
+    int n = len - 3;
+
+    if (len < 3)
+        return -1;
+    if (crc16(buf, len - 2) != (buf[len - 2] | buf[len - 1] << 8))
+        return -1;
+
+    switch (buf[0])
+    {
+    case FRAME_CURSOR:
+        if (n != 3)
+            return -1;
+        printf("cursor line=%u column=%u symbol=0x%02x\n",
+               payload[0], payload[1], payload[2]);
+        break;
+
+    case FRAME_ISRSTAT:
+        if (n != 11)
+            return -1;
+        // Times in Timer/Counter1 ticks, 0.5 us with prescaler 8
+        printf("isr%u n=%u min=%.1fus avg=%.1fus max=%.1fus lat=%.1fus\n",
+               payload[0],
+               payload[1] | payload[2] << 8,
+               (payload[3] | payload[4] << 8) * 0.5,
+               (payload[5] | payload[6] << 8) * 0.5,
+               (payload[7] | payload[8] << 8) * 0.5,
+               (payload[9] | payload[10] << 8) * 0.5);
+        break;
+
+    case FRAME_SAMPLES:
+        if (n % 2)
+            return -1;
+        // ADC channel in bits 15..12, 10-bit sample below
+        printf("samples");
+        for (int i = 0; i < n; i += 2)
+            printf(" %u:%u", payload[i + 1] >> 4,
+                   (payload[i] | payload[i + 1] << 8) & 0x0fff);
+        printf("\n");
+        break;
+
+    default:
+        printf("type=0x%02x len=%d:", buf[0], n);
+        for (int i = 0; i < n; i++)
+            printf(" %02x", payload[i]);
+        printf("\n");
+        break;
+    }
+    fflush(stdout);
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint8_t frame[FRAME_SIZE_MAX];
+    uint8_t rx[64];
+    size_t len = 0;
+    int overrun = 0;
+    unsigned long valid = 0;
+    unsigned long invalid = 0;
+    int fd = STDIN_FILENO;
+    ssize_t n;
+
+    if (argc > 1)
+    {
+        fd = serial_open(argv[1], (argc > 2) ? strtoul(argv[2], NULL, 10) : 250000);
+        if (fd < 0)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    while ((n = read(fd, rx, sizeof(rx))) > 0)
+    {
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (rx[i] != FRAME_DELIMITER)
+            {
+                // Drop bytes of too long frame until the next delimiter
+                if (len < sizeof(frame))
+                    frame[len++] = rx[i];
+                else
+                    overrun = 1;
+                continue;
+            }
+
+            if (len != 0)
+            {
+                int dec = overrun ? -1 : cobs_decode(frame, len);
+
+                if (dec >= 0 && frame_print(frame, dec) == 0)
+                {
+                    valid++;
+                }
+                else
+                {
+                    invalid++;
+                    fprintf(stderr, "invalid frame (%zu bytes), %lu of %lu\n",
+                            len, invalid, valid + invalid);
+                }
+            }
+            len = 0;
+            overrun = 0;
+        }
+    }
+
+    return 0;
+}